@@ -0,0 +1,89 @@
+#!/usr/bin/python3
+
+import argparse
+import csv
+import ctypes
+import importlib.util
+import os
+import sys
+import tempfile
+import time
+
+import topology
+
+# pathopt.so sits next to pathopt.py and would be imported in its place
+spec = importlib.util.spec_from_file_location("pathopt", os.path.join(os.path.dirname(os.path.abspath(__file__)), "pathopt.py"))
+pathopt = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(pathopt)
+
+# One row per run in the output file
+FIELDS = ["family", "nodes", "edges", "metrics", "degree", "correlation", "seed", "engine", "threads",
+          "parse_seconds", "optimize_seconds", "write_seconds", "write_binary_seconds", "paths"]
+
+def bench_graph(filename, engine, threads, workdir):
+    # Times the parse, optimize and write phases of one graph
+    libc = ctypes.CDLL(None)
+    libc.fopen.restype = ctypes.c_void_p
+    libc.fopen.argtypes = [ctypes.c_char_p, ctypes.c_char_p]
+    libc.fclose.argtypes = [ctypes.c_void_p]
+
+    start = time.perf_counter()
+    po = pathopt.PathOpt(filename, engine=engine, threads=threads, optimize=False)
+    parsed = time.perf_counter()
+    po.start(threads)
+    po.wait()
+    optimized = time.perf_counter()
+
+    # The text writer, the way the command line writes results
+    text_name = os.path.join(workdir, "results.txt")
+    outfile = libc.fopen(text_name.encode('utf-8'), b"w")
+    po.pathopt.write_optimized_paths.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+    po.pathopt.write_optimized_paths(po.ctx, outfile)
+    libc.fclose(outfile)
+    written = time.perf_counter()
+
+    binary_name = os.path.join(workdir, "results.bin")
+    po.write_results(binary_name)
+    written_binary = time.perf_counter()
+    po.close()
+
+    return {"parse_seconds": parsed - start, "optimize_seconds": optimized - parsed,
+            "write_seconds": written - optimized, "write_binary_seconds": written_binary - written,
+            "paths": pathopt.PathResults(binary_name).path_count}
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Times parse, optimize and write on synthetic topologies")
+    parser.add_argument("-f", "--families", nargs="+", default=sorted(topology.FAMILIES), choices=sorted(topology.FAMILIES))
+    parser.add_argument("-n", "--sizes", nargs="+", type=int, default=[25, 50, 100, 200])
+    parser.add_argument("-e", "--engines", nargs="+", default=["label"], choices=["label", "rounds"])
+    parser.add_argument("-j", "--threads", nargs="+", type=int, default=[1])
+    parser.add_argument("-d", "--degree", type=int, default=4)
+    parser.add_argument("-m", "--metrics", type=int, default=3)
+    parser.add_argument("-c", "--correlation", type=float, default=0.0)
+    parser.add_argument("-s", "--seed", type=int, default=1)
+    parser.add_argument("-o", "--output", default=os.path.join(tempfile.gettempdir(), "pathopt-bench.csv"),
+                        help="CSV file to write (default pathopt-bench.csv in the temp directory)")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as workdir, open(args.output, "w", newline="") as output:
+        writer = csv.DictWriter(output, fieldnames=FIELDS)
+        writer.writeheader()
+        print(" ".join("%-10s" % field.replace("_seconds", "") for field in FIELDS))
+        for family in args.families:
+            for size in args.sizes:
+                graph_name = os.path.join(workdir, "graph.txt")
+                with open(graph_name, "w") as graph:
+                    nodes, edges = topology.write_topology(graph, family, size, args.degree, args.metrics,
+                                                           args.correlation, args.seed)
+                for engine in args.engines:
+                    for threads in args.threads:
+                        row = {"family": family, "nodes": nodes, "edges": edges, "metrics": args.metrics,
+                               "degree": args.degree, "correlation": args.correlation, "seed": args.seed,
+                               "engine": engine, "threads": threads}
+                        row.update(bench_graph(graph_name, engine, threads, workdir))
+                        writer.writerow(row)
+                        output.flush()
+                        print(" ".join("%-10.4f" % row[field] if isinstance(row[field], float) else "%-10s" % row[field]
+                                       for field in FIELDS))
+                        sys.stdout.flush()
+    print("Wrote %s" % args.output)
@@ -0,0 +1,187 @@
+#include <stdbool.h> // true, false
+#include <stdio.h>   // printf
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "global.h"
+#include "dominance.h"
+
+/******************************
+ * Dominance Kernel Functions *
+ ******************************/
+
+/*
+ * dominates_vector - Determine if a metric vector dominates another one
+ *
+ * Arguments:
+ *   first  - Normalized metric vector to see if it dominates the other one
+ *   second - Normalized metric vector to compare against
+ *   size   - Number of metrics in each vector
+ *
+ * Vectors are normalized so smaller is better on every metric.  first
+ * dominates second when it is no larger on every metric and smaller on at
+ * least one.  Compares four metrics per instruction with AVX or two with
+ * SSE2, then finishes any remaining metric with scalar code.  Returns true
+ * or false, exactly like dominates_vector_scalar.
+ */
+int dominates_vector(const double *first, const double *second, int size) {
+  int worse = 0, better = 0, i = 0;
+
+#if defined(__AVX__)
+  for (; i + 4 <= size; i += 4) {
+    __m256d value1 = _mm256_loadu_pd(first + i);
+    __m256d value2 = _mm256_loadu_pd(second + i);
+    worse |= _mm256_movemask_pd(_mm256_cmp_pd(value1, value2, _CMP_GT_OQ));
+    better |= _mm256_movemask_pd(_mm256_cmp_pd(value1, value2, _CMP_LT_OQ));
+  }
+#endif
+#if defined(__SSE2__)
+  for (; i + 2 <= size; i += 2) {
+    __m128d value1 = _mm_loadu_pd(first + i);
+    __m128d value2 = _mm_loadu_pd(second + i);
+    worse |= _mm_movemask_pd(_mm_cmpgt_pd(value1, value2));
+    better |= _mm_movemask_pd(_mm_cmplt_pd(value1, value2));
+  }
+#endif
+  for (; i < size; i++) {
+    if (first[i] > second[i]) worse = 1;
+    if (first[i] < second[i]) better = 1;
+  }
+
+  return (worse == 0 && better != 0);
+}
+
+/*
+ * dominates_vector_scalar - Plain C version of dominates_vector
+ *
+ * Arguments:
+ *   first  - Normalized metric vector to see if it dominates the other one
+ *   second - Normalized metric vector to compare against
+ *   size   - Number of metrics in each vector
+ *
+ * Used where no vector instructions are available and by test_dominance to
+ * check the vector kernels.
+ */
+int dominates_vector_scalar(const double *first, const double *second, int size) {
+  int better = 0, worse = 0;
+  for (int i=0; i < size; i++) {
+    if (first[i] < second[i]) better++;
+    if (first[i] > second[i]) worse++;
+  }
+  return (better > 0 && worse == 0);
+}
+
+/*
+ * dominance_find - Finds the first row that dominates a candidate
+ *
+ * Arguments:
+ *   rows      - count metric vectors stored one after the other
+ *   count     - Number of rows
+ *   size      - Number of metrics in each row
+ *   candidate - Normalized metric vector to test
+ *
+ * Compares the candidate against several front members at once (see
+ * dominance_find_sse2), using the AVX kernel when the processor has it.
+ * Returns the index of the first row that dominates the candidate, or count
+ * if none does, exactly like dominance_find_scalar.
+ */
+int dominance_find(const double *rows, int count, int size, const double *candidate) {
+#if defined(__SSE2__) && defined(__GNUC__)
+  if (__builtin_cpu_supports("avx")) return dominance_find_avx(rows, count, size, candidate);
+#endif
+#if defined(__SSE2__)
+  return dominance_find_sse2(rows, count, size, candidate);
+#else
+  return dominance_find_scalar(rows, count, size, candidate);
+#endif
+}
+
+#if defined(__SSE2__)
+/*
+ * dominance_find_sse2 - dominance_find two front members at a time
+ *
+ * Arguments:
+ *   rows      - count metric vectors stored one after the other
+ *   count     - Number of rows
+ *   size      - Number of metrics in each row
+ *   candidate - Normalized metric vector to test
+ *
+ * Each lane holds one row: for every metric the two rows' values are
+ * compared with the candidate's in one instruction, collecting per row
+ * whether it is worse anywhere and better anywhere.  The first lane that is
+ * better somewhere and worse nowhere is the answer.  Rows left over at the
+ * end use the scalar kernel.
+ */
+int dominance_find_sse2(const double *rows, int count, int size, const double *candidate) {
+  int i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const double *row = rows + i * size;
+    int worse = 0, better = 0;
+    for (int m=0; m < size; m++) {
+      __m128d values = _mm_set_pd(row[size + m], row[m]);
+      __m128d value = _mm_set1_pd(candidate[m]);
+      worse |= _mm_movemask_pd(_mm_cmpgt_pd(values, value));
+      better |= _mm_movemask_pd(_mm_cmplt_pd(values, value));
+    }
+    int dominators = better & ~worse;
+    if (dominators != 0) return i + __builtin_ctz(dominators);
+  }
+  for (; i < count; i++) {
+    if (dominates_vector_scalar(rows + i * size, candidate, size)) return i;
+  }
+  return count;
+}
+#endif
+
+#if defined(__SSE2__) && defined(__GNUC__)
+/*
+ * dominance_find_avx - dominance_find four front members at a time
+ *
+ * Arguments:
+ *   rows      - count metric vectors stored one after the other
+ *   count     - Number of rows
+ *   size      - Number of metrics in each row
+ *   candidate - Normalized metric vector to test
+ *
+ * dominance_find_sse2 with four lanes.  Compiled for AVX whatever the
+ * build flags are, so only call it when __builtin_cpu_supports("avx").
+ */
+__attribute__((target("avx")))
+int dominance_find_avx(const double *rows, int count, int size, const double *candidate) {
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const double *row = rows + i * size;
+    int worse = 0, better = 0;
+    for (int m=0; m < size; m++) {
+      __m256d values = _mm256_set_pd(row[3 * size + m], row[2 * size + m], row[size + m], row[m]);
+      __m256d value = _mm256_set1_pd(candidate[m]);
+      worse |= _mm256_movemask_pd(_mm256_cmp_pd(values, value, _CMP_GT_OQ));
+      better |= _mm256_movemask_pd(_mm256_cmp_pd(values, value, _CMP_LT_OQ));
+    }
+    int dominators = better & ~worse;
+    if (dominators != 0) return i + __builtin_ctz(dominators);
+  }
+  for (; i < count; i++) {
+    if (dominates_vector_scalar(rows + i * size, candidate, size)) return i;
+  }
+  return count;
+}
+#endif
+
+/*
+ * dominance_find_scalar - Plain C version of dominance_find
+ *
+ * Arguments:
+ *   rows      - count metric vectors stored one after the other
+ *   count     - Number of rows
+ *   size      - Number of metrics in each row
+ *   candidate - Normalized metric vector to test
+ */
+int dominance_find_scalar(const double *rows, int count, int size, const double *candidate) {
+  for (int i=0; i < count; i++) {
+    if (dominates_vector_scalar(rows + i * size, candidate, size)) return i;
+  }
+  return count;
+}
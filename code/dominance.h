@@ -0,0 +1,19 @@
+#ifndef DOMINANCE_H
+#define DOMINANCE_H
+
+/******************************
+ * Dominance Kernel Functions *
+ ******************************/
+
+int dominates_vector(const double *first, const double *second, int size);
+int dominates_vector_scalar(const double *first, const double *second, int size);
+int dominance_find(const double *rows, int count, int size, const double *candidate);
+int dominance_find_scalar(const double *rows, int count, int size, const double *candidate);
+#if defined(__SSE2__)
+int dominance_find_sse2(const double *rows, int count, int size, const double *candidate);
+#endif
+#if defined(__SSE2__) && defined(__GNUC__)
+int dominance_find_avx(const double *rows, int count, int size, const double *candidate);
+#endif
+
+#endif
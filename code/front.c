@@ -0,0 +1,291 @@
+#include <string.h>  // memmove
+#include <stdlib.h>  // realloc
+#include <stdbool.h> // true, false
+#include <stdio.h>   // printf
+
+#include "global.h"
+#include "metrics.h"
+#include "paths.h"
+#include "dominance.h"
+#include "front.h"
+
+/**************************
+ * Pareto Front Functions *
+ **************************/
+
+/*
+ * front_search - Finds where a path belongs in a collection's front
+ *
+ * Arguments:
+ *   collection - Collection whose front to search
+ *   path       - Path to look for
+ *
+ * The front is kept sorted with compare_paths_lex.  Binary searches for the
+ * first member that comes after the path, so every member before the
+ * returned index is lexicographically less than or equal to the path.
+ */
+int front_search(pathopt_ctx *ctx, path_collection_struct *collection, path_struct *path) {
+  int low = 0, high = collection->count;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (compare_paths_lex(ctx, collection->paths[mid], path) <= 0) low = mid + 1;
+    else high = mid;
+  }
+  return low;
+}
+
+/*
+ * front_configure - Picks the front kernel for the current graph
+ *
+ * A metric is trivial when every path has the same value for it: MIN or
+ * MAX combination over edges that all share one value, or ADD of all-zero
+ * edges with no extra argument.  Trivial metrics never decide dominance,
+ * so when at most two metrics are left the fronts use the bi-objective
+ * kernel.  The same pass sets front_monotone: a metric is monotone when
+ * extending a path can never make it better (ADD of edges that are never
+ * better than zero, or the combination that keeps the worse value), which
+ * is what destination bounds in path_query rely on.  Call after the
+ * adjacency is built and before optimizing.
+ */
+void front_configure(pathopt_ctx *ctx) {
+  int objectives = 0;
+
+  ctx->front_mode = FRONT_GENERAL;
+  ctx->front_monotone = true;
+  for(int i=0; i < ctx->global_metric_total; i++) {
+    global_metric_struct *gms = ctx->global_metric_table[i];
+    int trivial = true;
+    int edges = ctx->adj_offsets[ctx->global_node_total];
+    for(int edge=0; edge < edges && (trivial || ctx->front_monotone); edge++) {
+      double value = ctx->adj_metrics[edge * ctx->global_metric_total + i];
+      if (gms->combo == COMBO_ADD) {
+	trivial = trivial && (value == 0 && gms->arg == 0);
+	ctx->front_monotone = ctx->front_monotone && (value + gms->arg * gms->sign >= 0);
+      } else {
+	trivial = trivial && (value == ctx->adj_metrics[i]);
+	// combine_metrics keeps the smaller normalized value for these, which can improve a path
+	if ((gms->combo == COMBO_MIN) == (gms->sign > 0)) ctx->front_monotone = ctx->front_monotone && trivial;
+      }
+    }
+    if (trivial) continue;
+    if (objectives < 2) ctx->front_objective[objectives] = i;
+    objectives++;
+  }
+
+  // A single objective uses the same kernel with both ordinals the same
+  if (objectives == 0 || objectives > 2) return; // More than two objectives
+  if (objectives == 1) ctx->front_objective[1] = ctx->front_objective[0];
+  ctx->front_mode = FRONT_BIOBJECTIVE;
+  if (DEBUG) printf("front_configure: bi-objective on metrics %d and %d\n", ctx->front_objective[0], ctx->front_objective[1]);
+}
+
+/*
+ * front_reserve - Makes room for one more path in a front
+ *
+ * Arguments:
+ *   collection - Collection whose front to grow
+ *
+ * Grows the path array and the matching metric rows together.
+ */
+void front_reserve(pathopt_ctx *ctx, path_collection_struct *collection) {
+  if (collection->count < collection->capacity) return;
+  int capacity = (collection->capacity == 0) ? (4) : (collection->capacity * 2);
+  path_struct **paths = realloc(collection->paths, capacity * sizeof(path_struct *));
+  if (paths != NULL) collection->paths = paths;
+  double *values = realloc(collection->values, capacity * (ctx->global_metric_total > 0 ? ctx->global_metric_total : 1) * sizeof(double));
+  if (values != NULL) collection->values = values;
+  if (paths == NULL || values == NULL) {
+    printf("Memory Allocation failed: front_reserve(%d)\n", capacity);
+    exit(1);
+  }
+  collection->capacity = capacity;
+}
+
+/*
+ * front_move - Moves front members (paths and metric rows) within a front
+ *
+ * Arguments:
+ *   collection - Collection whose front to update
+ *   to         - Destination index
+ *   from       - Source index
+ *   count      - Number of members to move
+ */
+void front_move(pathopt_ctx *ctx, path_collection_struct *collection, int to, int from, int count) {
+  int k = ctx->global_metric_total;
+  if (count <= 0 || to == from) return;
+  memmove(collection->paths + to, collection->paths + from, count * sizeof(path_struct *));
+  memmove(collection->values + to * k, collection->values + from * k, count * k * sizeof(double));
+}
+
+/*
+ * front_place - Stores a path and its metric row at a front index
+ *
+ * Arguments:
+ *   collection - Collection whose front to update
+ *   index      - Index to store at
+ *   path       - Path to store
+ */
+void front_place(pathopt_ctx *ctx, path_collection_struct *collection, int index, path_struct *path) {
+  collection->paths[index] = path;
+  copy_metrics(ctx, collection->values + index * ctx->global_metric_total, path->metrics);
+}
+
+/*
+ * front_insert - Adds a path to a front and evicts what it dominates
+ *
+ * Arguments:
+ *   collection - Collection whose front to update
+ *   path       - Path to insert
+ *
+ * A dominating path is better or equal on every metric, so it always comes
+ * earlier in lexicographic order.  That means only the members before the
+ * path's position can dominate it (or be duplicates, which have equal
+ * metrics), and only the members after it can be dominated by it.  Both
+ * checks are done in one pass over the front, using the vector dominance
+ * kernel on the front's contiguous metric rows.  Only the position search is
+ * sub-linear here: with three or more objectives the dominator check and
+ * the eviction scan stay linear in the front size per insert (there is no
+ * ND-tree or quad-tree index).  Two objectives go to
+ * front_insert_biobjective, which is logarithmic.  Returns 1 if the path
+ * was inserted (the front now owns the caller's reference) or 0 if not.
+ */
+int front_insert(pathopt_ctx *ctx, path_collection_struct *collection, path_struct *path) {
+  if (ctx->front_mode == FRONT_BIOBJECTIVE) return front_insert_biobjective(ctx, collection, path);
+  int k = ctx->global_metric_total;
+  int pos = front_search(ctx, collection, path);
+
+  // Duplicates have the same metrics, so they sit right before pos
+  for(int i=pos-1; i >= 0 && compare_paths_lex(ctx, collection->paths[i], path) == 0; i--) {
+    if (duplicate_path(collection->paths[i], path)) return 0;
+  }
+  // Domination check against the earlier members
+  int dominator = dominance_find(collection->values, pos, k, path->metrics);
+  if (ctx->stats_enabled) ctx->source_stats[path->srcid].dominance_checks += (dominator < pos) ? (dominator + 1) : (pos);
+  if (dominator < pos) return 0;
+
+  // Make room for one more path
+  front_reserve(ctx, collection);
+
+  // Evict the later members the path dominates, compacting as we go
+  int keep = pos;
+  for(int i=pos; i < collection->count; i++) {
+    path_struct *member = collection->paths[i];
+    if (dominates_vector(path->metrics, collection->values + i * k, k)) {
+      member->active = false;
+      delete_path(ctx, member);
+    } else {
+      front_move(ctx, collection, keep++, i, 1);
+    }
+  }
+  if (ctx->stats_enabled) {
+    ctx->source_stats[path->srcid].dominance_checks += collection->count - pos;
+    ctx->source_stats[path->srcid].evictions += collection->count - keep;
+  }
+
+  // Insert the path at its position
+  front_move(ctx, collection, pos + 1, pos, keep - pos);
+  front_place(ctx, collection, pos, path);
+  collection->count = keep + 1;
+  collection->dirty = true;
+  path->active = true;
+  return 1;
+}
+
+/*
+ * front_insert_biobjective - front_insert for two objectives
+ *
+ * Arguments:
+ *   collection - Collection whose front to update
+ *   path       - Path to insert
+ *
+ * With two objectives (a, b) the front is a staircase: sorted on a, the b
+ * values never increase.  So the last member before the path's position has
+ * the best b of every possible dominator, and the members the path dominates
+ * are the run right after its position whose b is not better than its own.
+ * Both are found by binary search.  Returns 1 if the path was inserted or 0
+ * if not, like front_insert.
+ */
+int front_insert_biobjective(pathopt_ctx *ctx, path_collection_struct *collection, path_struct *path) {
+  int k = ctx->global_metric_total;
+  int a = ctx->front_objective[0], b = ctx->front_objective[1];
+  double path_b = path->metrics[b];
+  int pos = front_search(ctx, collection, path);
+  int checks = 0;
+
+  if (pos > 0) {
+    checks++;
+    path_struct *member = collection->paths[pos - 1];
+    if (compare_paths_lex(ctx, member, path) == 0) {
+      // Equal metrics never dominate, but may be duplicates
+      for(int i=pos-1; i >= 0 && compare_paths_lex(ctx, collection->paths[i], path) == 0; i--) {
+	if (duplicate_path(collection->paths[i], path)) return 0;
+      }
+    } else if (collection->values[(pos - 1) * k + b] <= path_b) {
+      if (ctx->stats_enabled) ctx->source_stats[path->srcid].dominance_checks += checks;
+      return 0; // Dominated (no worse on a, no worse on b, not equal)
+    }
+  }
+
+  // The dominated run ends at the first later member with a better b
+  int low = pos, high = collection->count;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (collection->values[mid * k + b] >= path_b) low = mid + 1;
+    else high = mid;
+    checks++;
+  }
+  int end = low;
+  if (ctx->stats_enabled) {
+    ctx->source_stats[path->srcid].dominance_checks += checks;
+    ctx->source_stats[path->srcid].evictions += end - pos;
+  }
+  if (DEBUG && end > pos && collection->values[pos * k + a] < path->metrics[a]) {
+    printf("front_insert_biobjective: front is out of order\n");
+  }
+
+  // Evict the run and insert the path in its place
+  for(int i=pos; i < end; i++) {
+    collection->paths[i]->active = false;
+    delete_path(ctx, collection->paths[i]);
+  }
+  if (end == pos) front_reserve(ctx, collection);
+  front_move(ctx, collection, pos + 1, end, collection->count - end);
+  front_place(ctx, collection, pos, path);
+  collection->count += 1 - (end - pos);
+  collection->dirty = true;
+  path->active = true;
+  return 1;
+}
+
+/*
+ * front_remove - Removes one member from a front
+ *
+ * Arguments:
+ *   collection - Collection whose front to update
+ *   index      - Position of the member to remove
+ *
+ * Releases the front's reference to the path and closes the gap.
+ */
+void front_remove(pathopt_ctx *ctx, path_collection_struct *collection, int index) {
+  path_struct *member = collection->paths[index];
+  member->active = false;
+  delete_path(ctx, member);
+  collection->count--;
+  front_move(ctx, collection, index, index + 1, collection->count - index);
+}
+
+/*
+ * front_clear - Removes every member from a front
+ *
+ * Arguments:
+ *   collection - Collection whose front to empty
+ *
+ * Releases the front's reference to each path.  The array is kept for reuse.
+ */
+void front_clear(pathopt_ctx *ctx, path_collection_struct *collection) {
+  for(int i=0; i < collection->count; i++) {
+    collection->paths[i]->active = false;
+    delete_path(ctx, collection->paths[i]);
+  }
+  collection->count = 0;
+}
@@ -0,0 +1,18 @@
+#ifndef FRONT_H
+#define FRONT_H
+
+/**************************
+ * Pareto Front Functions *
+ **************************/
+
+void front_configure(pathopt_ctx *ctx);
+void front_reserve(pathopt_ctx *ctx, path_collection_struct *collection);
+void front_move(pathopt_ctx *ctx, path_collection_struct *collection, int to, int from, int count);
+void front_place(pathopt_ctx *ctx, path_collection_struct *collection, int index, path_struct *path);
+int front_search(pathopt_ctx *ctx, path_collection_struct *collection, path_struct *path);
+int front_insert(pathopt_ctx *ctx, path_collection_struct *collection, path_struct *path);
+int front_insert_biobjective(pathopt_ctx *ctx, path_collection_struct *collection, path_struct *path);
+void front_remove(pathopt_ctx *ctx, path_collection_struct *collection, int index);
+void front_clear(pathopt_ctx *ctx, path_collection_struct *collection);
+
+#endif
@@ -3,15 +3,14 @@
 #include <string.h>
 #include "global.h"
 
+#include "metrics.h"
 #include "graph.h"
+#include "paths.h"
+#include "snapshot.h"
 
 /*******************************
  * Initialize Global Variables *
  *******************************/
-global_metric_struct *global_metrics;               // Keeps track of list of metrics
-global_node_struct *global_nodes;                   // Keeps track of the list of nodes
-edge_struct *edge_hash_table[HASH_SIZE];            // Keeps track of edges
-path_collection_struct *path_hash_table[HASH_SIZE]; // Keeps track of non-dominated paths
 
 // CLI variables
 int verbose;                     // verbose debugging level
@@ -19,9 +18,64 @@ char infile[NAME_MAX_LENGTH];    // Used for input when not stdin
 char outfile[NAME_MAX_LENGTH];   // Used for output when not stdout
 char debugfile[NAME_MAX_LENGTH]; // Used for output when not stdout
 
-// Global Initialization function
-void global_initialize() {
-  global_metrics = NULL;
-  global_nodes = NULL;
-  init_global_edge_table();
+/*
+ * pathopt_create - Creates an empty optimizer context
+ *
+ * Allocates the context with the default options, no metrics, no nodes,
+ * no edges and no path table.  Release it with pathopt_destroy.
+ */
+pathopt_ctx *pathopt_create() {
+  pathopt_ctx *ctx = calloc(1, sizeof(pathopt_ctx));
+  if (ctx == NULL) {
+    printf("Memory Allocation failed: pathopt_create()\n");
+    exit(1);
+  }
+  // calloc leaves every table empty; only the non-zero defaults are set
+  ctx->optimize_engine = ENGINE_LABEL;
+  ctx->parse_mode = PARSE_MMAP;
+  ctx->parse_threads = 1;
+  ctx->optimize_threads = 1;
+  init_global_edge_table(ctx);
+  pthread_mutex_init(&ctx->progress_lock, NULL);
+  return ctx;
+}
+
+/*
+ * pathopt_configure - Sets the options of a context
+ *
+ * Arguments:
+ *   ctx     - Optimizer context
+ *   engine  - ENGINE_ROUNDS or ENGINE_LABEL
+ *   mode    - PARSE_STREAM or PARSE_MMAP
+ *   threads - Threads for parsing the [edges] section
+ */
+void pathopt_configure(pathopt_ctx *ctx, int engine, int mode, int threads) {
+  ctx->optimize_engine = engine;
+  ctx->parse_mode = mode;
+  ctx->parse_threads = (threads > 0) ? (threads) : (1);
+}
+
+/*
+ * pathopt_destroy - Frees an optimizer context and everything it owns
+ *
+ * Arguments:
+ *   ctx - Context from pathopt_create (NULL is ignored)
+ *
+ * Cancels and waits for a path_optimize_start run, then frees the path
+ * table and path pools, the CSR index, the edges with their metric vectors,
+ * the nodes, the metric schema and finally unmaps the snapshot the graph
+ * was loaded from, if any.
+ */
+void pathopt_destroy(pathopt_ctx *ctx) {
+  if (ctx == NULL) return;
+  path_optimize_cancel(ctx);
+  path_optimize_wait(ctx);
+  free_global_path_table(ctx);
+  free_global_adjacency(ctx);
+  free_global_edge_table(ctx);
+  free_global_nodes(ctx);
+  free_global_metrics(ctx);
+  free_snapshot(ctx);
+  pthread_mutex_destroy(&ctx->progress_lock);
+  free(ctx);
 }
@@ -1,6 +1,11 @@
 #ifndef GLOBAL_H
 #define GLOBAL_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
 #define DEBUG 0
 
 // Optimization options for metrics
@@ -17,6 +22,38 @@
 #define SECTION_NODES 1
 #define SECTION_EDGES 2
 
+// Parser modes
+#define PARSE_STREAM 0
+#define PARSE_MMAP 1
+
+// Smallest [edges] chunk worth a parser thread
+#define PARSE_CHUNK_BYTES (1 << 20)
+
+// Compiled graph snapshots
+#define SNAPSHOT_MAGIC "PATHOPTG"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+// Binary result files
+#define RESULTS_MAGIC "PATHOPTR"
+#define RESULTS_VERSION 1
+#define RESULTS_BUFFER_BYTES (1 << 20)
+
+// Optimization engines
+#define ENGINE_ROUNDS 0
+#define ENGINE_LABEL 1
+
+// Pareto front kernels
+#define FRONT_GENERAL 0
+#define FRONT_BIOBJECTIVE 1
+
+// Timed phases (see pathopt_stats)
+#define PHASE_PARSE 0
+#define PHASE_INIT 1
+#define PHASE_OPTIMIZE 2
+#define PHASE_WRITE 3
+#define PHASE_TOTAL 4
+
 // Status values
 #define ERROR -1
 
@@ -24,8 +61,14 @@
 #define BUFFER_LEN 512
 #define NAME_MAX_LENGTH 50
 
-// Hash Map
-#define HASH_SIZE 37
+// Hash Map (initial capacity, always a power of two)
+#define HASH_INITIAL_SIZE 64
+
+// Visited node signature bit for a node id
+#define VISITED_BIT(id) (1ULL << ((unsigned int)(id) & 63))
+
+// Object pools
+#define POOL_BLOCK_OBJECTS 256
 
 /***********
  * Structs *
@@ -37,58 +80,282 @@ typedef struct global_metric_struct {
   unsigned int opt;           // Optimization method
   unsigned int combo;         // Combination method
   double arg;                 // Optional additional argument
+  int index;                  // Ordinal of the metric in every metric vector
+  double sign;                // Stored values are value * sign (-1 for OPT_MAX), so smaller is better
   struct global_metric_struct *next;
 } global_metric_struct;
 
-// Edge Metrics
-typedef struct metric_struct {
-  char name[NAME_MAX_LENGTH]; // Metric name
-  double value;
-  struct metric_struct *next;
-} metric_struct;
-
 // Global Edges
 typedef struct edge_struct {
-  char srcname[NAME_MAX_LENGTH];
-  char dstname[NAME_MAX_LENGTH];
-  metric_struct *metrics;
-  struct edge_struct *next;
+  int srcid;                  // Source node id
+  int dstid;                  // Destination node id
+  double *metrics;            // Normalized metric vector (one value per global metric)
 } edge_struct;
 
 // Global Nodes
 typedef struct global_node_struct {
   char name[NAME_MAX_LENGTH];
   char description[NAME_MAX_LENGTH];
+  int id;                     // Dense node id (index in global_node_table)
+  int removed;                // True once the node is removed (its id is not reused)
   struct global_node_struct *next;
 } global_node_struct;
 
-// Local Nodes
-typedef struct node_struct {
-  char name[NAME_MAX_LENGTH];
-  struct node_struct *next;
-} node_struct;
-
-// Path Object
+// Path Object (a label: the parent path plus one more hop to dstid)
 typedef struct path_struct {
-  char srcname[NAME_MAX_LENGTH];
-  char dstname[NAME_MAX_LENGTH];
-  node_struct *nodes;
-  metric_struct *metrics;
-  struct path_struct *next;
+  int srcid;                  // Source node id
+  int dstid;                  // Destination (tail) node id
+  int length;                 // Number of nodes in the path
+  int refs;                   // Owners: a collection, caller or heap, plus each extending path
+  int active;                 // True while the path is in its collection
+  int expanded;               // True once the path has been extended along its tail's out-edges
+  unsigned long long visited; // Signature of the nodes in the path (bit id % 64 per node)
+  struct path_struct *parent; // Path this one extends (NULL for a direct edge)
+  double metrics[];           // Normalized metric vector (one value per global metric)
 } path_struct;
 
 // Path Hash Table
 typedef struct path_collection_struct {
-  char srcname[NAME_MAX_LENGTH];
-  char dstname[NAME_MAX_LENGTH];
-  path_struct *optlist;
-  struct path_collection_struct *next;
+  int srcid;                  // Source node id
+  int dstid;                  // Destination node id
+  path_struct **paths;        // Pareto front, sorted by compare_paths_lex
+  double *values;             // Metric rows of the front, count * global_metric_total
+  int count;                  // Paths in the front
+  int capacity;               // Room in the paths array
+  int dirty;                  // True when paths were added since the collection was last expanded
 } path_collection_struct;
 
+// Flat view of one pair's Pareto front (filled in by path_front_export)
+typedef struct path_front_struct {
+  int count;                  // Paths in the front
+  int metric_count;           // Metric values per path
+  const double *values;       // count rows of normalized metrics (the collection's own rows)
+  const int *offsets;         // count + 1 entries: path p has nodes [offsets[p], offsets[p + 1])
+  const int *nodes;           // Node ids of every path, source first
+} path_front_struct;
+
+// Path Heap (binary min-heap in lexicographic metric order)
+typedef struct path_heap_struct {
+  struct path_struct **items;
+  int count;
+  int capacity;
+} path_heap_struct;
+
+// Work queue for optimizing sources on several threads
+typedef struct optimize_queue_struct {
+  struct pathopt_ctx *ctx;    // Context being optimized
+  pthread_mutex_t lock;       // Protects next
+  int next;                   // Next source id to hand out
+} optimize_queue_struct;
+
+// Progress of an optimization run (see path_optimize_progress)
+typedef struct optimize_progress_struct {
+  int sources_done;           // Sources optimized so far
+  int source_total;           // Sources in the run
+  unsigned long paths;        // Paths added to fronts so far
+  int running;                // True while the run is in progress
+  int cancelled;              // True once path_optimize_cancel stopped the run
+} optimize_progress_struct;
+
+// Part of an [edges] section parsed by one thread
+typedef struct parse_chunk_struct {
+  struct pathopt_ctx *ctx;    // Context the edges belong to
+  const char *start;          // First line of the chunk
+  const char *end;            // End of the chunk (a line start or the end of the section)
+  int *ids;                   // srcid, dstid pair of each parsed edge
+  double **metrics;           // Metric vector of each parsed edge
+  int count;                  // Edges parsed
+  int capacity;               // Room in ids and metrics
+  char *messages;             // Error messages, printed when the chunk is merged
+  size_t message_length;      // Bytes in messages
+} parse_chunk_struct;
+
+// Compiled graph snapshot header (every offset is from the start of the file)
+typedef struct snapshot_header_struct {
+  char magic[8];              // SNAPSHOT_MAGIC
+  uint32_t version;           // SNAPSHOT_VERSION
+  uint32_t byte_order;        // SNAPSHOT_BYTE_ORDER as written by the compiling machine
+  uint32_t metric_count;      // Metric records
+  uint32_t node_count;        // Node records
+  uint32_t edge_count;        // Edges in the CSR arrays
+  uint32_t reserved;
+  uint64_t file_size;         // Bytes in the whole file
+  uint64_t checksum;          // snapshot_checksum of everything after the header
+  uint64_t names_offset;      // Interned names, each terminated with a zero byte
+  uint64_t metrics_offset;    // metric_count snapshot_metric_struct records
+  uint64_t nodes_offset;      // node_count snapshot_node_struct records
+  uint64_t offsets_offset;    // node_count + 1 int CSR offsets
+  uint64_t targets_offset;    // edge_count int destination ids
+  uint64_t values_offset;     // edge_count * metric_count normalized doubles
+} snapshot_header_struct;
+
+// Compiled graph snapshot metric record
+typedef struct snapshot_metric_struct {
+  uint32_t name;              // Offset of the name in the names section
+  uint32_t opt;               // Optimization method
+  uint32_t combo;             // Combination method
+  uint32_t reserved;
+  double arg;                 // Optional additional argument
+} snapshot_metric_struct;
+
+// Compiled graph snapshot node record (in node id order)
+typedef struct snapshot_node_struct {
+  uint32_t name;              // Offset of the name in the names section
+  uint32_t description;       // Offset of the description in the names section
+} snapshot_node_struct;
+
+// Binary result file header (every offset is from the start of the file)
+typedef struct results_header_struct {
+  char magic[8];              // RESULTS_MAGIC
+  uint32_t version;           // RESULTS_VERSION
+  uint32_t byte_order;        // SNAPSHOT_BYTE_ORDER as written by the writing machine
+  uint32_t metric_count;      // Metric columns
+  uint32_t node_count;        // Node ids are 0 to node_count - 1
+  uint64_t path_count;        // Paths over all pairs
+  uint64_t hop_count;         // Node ids over all paths
+  uint64_t file_size;         // Bytes in the whole file
+  uint64_t names_offset;      // Metric names then node names, each terminated with a zero byte
+  uint64_t name_index_offset; // metric_count + node_count uint32 offsets into the names
+  uint64_t pairs_offset;      // node_count^2 + 1 uint64: pair (src, dst) has paths [pairs[i], pairs[i + 1]), i = src * node_count + dst
+  uint64_t paths_offset;      // path_count + 1 uint64: path p has node ids [paths[p], paths[p + 1])
+  uint64_t nodes_offset;      // hop_count int node ids, source first
+  uint64_t values_offset;     // metric_count columns of path_count doubles (as in the input, full precision)
+} results_header_struct;
+
+// Buffered writer for binary result files
+typedef struct results_writer_struct {
+  FILE *file;                 // Output file
+  char *buffer;               // RESULTS_BUFFER_BYTES of pending output
+  size_t used;                // Bytes pending in buffer
+  uint64_t written;           // Bytes written so far (including pending)
+  int failed;                 // True once a write fails
+} results_writer_struct;
+
+// Binary result file opened for reading
+typedef struct results_struct {
+  char *data;                 // Mapped file
+  size_t size;                // Bytes in data
+  results_header_struct *header;
+  uint32_t *name_index;       // Name offsets (metrics, then nodes)
+  uint64_t *pairs;            // Path range of each pair
+  uint64_t *paths;            // Node id range of each path
+  int *nodes;                 // Node ids of all paths
+  double *values;             // Metric columns
+} results_struct;
+
+// Object Pool Block
+typedef struct pool_block_struct {
+  struct pool_block_struct *next;
+  double data[];              // Objects (double keeps them aligned)
+} pool_block_struct;
+
+// Object Pool (fixed size objects with a free list)
+typedef struct pool_struct {
+  size_t object_size;         // Bytes per object
+  size_t block_objects;       // Objects per block
+  pool_block_struct *blocks;  // Every block allocated by the pool
+  char *cursor;               // Next unused object in the newest block
+  char *limit;                // End of the newest block
+  void *free_list;            // Released objects, linked through their first word
+  unsigned long allocations;  // Objects handed out (including reuse)
+  unsigned long live;         // Objects currently in use
+  size_t bytes;               // Bytes currently held in blocks
+  size_t peak_bytes;          // Largest value of bytes
+} pool_struct;
+
+// Hot path counters for one source (only counted while stats_enabled is set)
+typedef struct source_stats_struct {
+  unsigned long extends;          // extend_path calls
+  unsigned long dominance_checks; // Front members compared with a new path
+  unsigned long accepts;          // add_path_attempt calls that kept the path
+  unsigned long rejects;          // add_path_attempt calls that dropped the path
+  unsigned long evictions;        // Front members evicted by a dominating path
+  unsigned long rounds;           // Rounds run by the rounds engine
+  unsigned long labels;           // Labels extended by the label engine
+  int peak_front;                 // Largest front of any (source, *) pair
+  int peak_dstid;                 // Destination of that front
+} source_stats_struct;
+
+// Counters and phase timers over all sources (filled in by pathopt_stats)
+typedef struct pathopt_stats_struct {
+  unsigned long extends;          // extend_path calls
+  unsigned long dominance_checks; // Front members compared with a new path
+  unsigned long accepts;          // add_path_attempt calls that kept the path
+  unsigned long rejects;          // add_path_attempt calls that dropped the path
+  unsigned long evictions;        // Front members evicted by a dominating path
+  unsigned long rounds;           // Rounds run by the rounds engine
+  unsigned long max_rounds;       // Most rounds any one source took
+  unsigned long labels;           // Labels extended by the label engine
+  int peak_front;                 // Largest front of any pair
+  int peak_srcid;                 // Source of that front (or ERROR)
+  int peak_dstid;                 // Destination of that front (or ERROR)
+  unsigned long allocations;      // Path objects handed out by the pools
+  size_t peak_bytes;              // Sum of the pools' peak block memory
+  double parse_seconds;           // Wall clock time in parse_file
+  double init_seconds;            // Wall clock time setting up path collections
+  double optimize_seconds;        // Wall clock time optimizing
+  double write_seconds;           // Wall clock time writing results
+} pathopt_stats_struct;
+
+// Optimizer context: one graph, its metric schema and its optimized paths.
+// Every function that works on a graph takes one, so a process can hold
+// and optimize several graphs at once (one thread per context at a time).
+typedef struct pathopt_ctx {
+  // Options
+  int optimize_engine;                       // ENGINE_ROUNDS or ENGINE_LABEL
+  int parse_mode;                            // PARSE_STREAM or PARSE_MMAP
+  int parse_threads;                         // Threads for the [edges] section (PARSE_MMAP)
+
+  // Metric schema and graph
+  global_metric_struct *global_metrics;      // Keeps track of list of metrics
+  global_metric_struct **global_metric_table; // Metric lookup by ordinal
+  int global_metric_total;                   // Number of metrics in global_metric_table
+  global_node_struct *global_nodes;          // Keeps track of the list of nodes
+  global_node_struct **global_node_table;    // Node lookup by id
+  int global_node_total;                     // Number of nodes in global_node_table
+  int *node_hash_table;                      // Node lookup by name (open addressing, holds ids)
+  unsigned int node_hash_capacity;           // Slots in node_hash_table
+  edge_struct *edge_hash_table;              // Edge lookup by (srcid, dstid) (open addressing)
+  unsigned int edge_hash_capacity;           // Slots in edge_hash_table
+  unsigned int edge_hash_used;               // Edges in edge_hash_table
+
+  // Compressed sparse row (CSR) adjacency, built once parsing completes
+  int *adj_offsets;                          // Out-edges of node i are [adj_offsets[i], adj_offsets[i+1])
+  int *adj_targets;                          // Destination node id of each out-edge
+  double *adj_metrics;                       // Normalized metric vector of each out-edge (global_metric_total wide)
+  char *snapshot_data;                       // Mapped snapshot the graph was loaded from (or NULL)
+  size_t snapshot_size;                      // Bytes in snapshot_data
+
+  // Optimized paths
+  path_collection_struct **path_table;       // Path collections, path_table[srcid][dstid]
+  pool_struct *path_pools;                   // Path objects, one pool per source node id
+  int front_mode;                            // FRONT_GENERAL or FRONT_BIOBJECTIVE
+  int front_objective[2];                    // Metric ordinals used by FRONT_BIOBJECTIVE
+  int front_monotone;                        // True if extending a path never improves a metric
+  int *export_offsets;                       // Offsets of the last path_front_export
+  int *export_nodes;                         // Node ids of the last path_front_export
+  int export_offsets_capacity;               // Room in export_offsets
+  int export_nodes_capacity;                 // Room in export_nodes
+
+  // Optimization runs (see path_optimize_start)
+  pthread_mutex_t progress_lock;             // Protects progress
+  optimize_progress_struct progress;         // Current or last run of path_optimize_all
+  pthread_t optimize_thread;                 // Thread running a path_optimize_start run
+  int optimize_started;                      // True until optimize_thread is joined
+  int optimize_threads;                      // Workers for the path_optimize_start run
+
+  // Instrumentation (see stats.c)
+  int stats_enabled;                         // True to count hot path events
+  source_stats_struct *source_stats;         // Hot path counters, one per source node id
+  double phase_seconds[PHASE_TOTAL];         // Wall clock time spent in each phase
+} pathopt_ctx;
+
 /********************
  * Global Variables *
  ********************/
-void global_initialize();
+pathopt_ctx *pathopt_create();
+void pathopt_configure(pathopt_ctx *ctx, int engine, int mode, int threads);
+void pathopt_destroy(pathopt_ctx *ctx);
 
 // Command line flags
 extern int verbose;                     // verbose debugging level
@@ -96,10 +363,4 @@ extern char infile[NAME_MAX_LENGTH];    // Used for input when not stdin
 extern char outfile[NAME_MAX_LENGTH];   // Used for output when not stdout
 extern char debugfile[NAME_MAX_LENGTH]; // Used for output when not stdout
 
-// Internal data structures
-extern global_metric_struct *global_metrics;               // Keeps track of list of metrics
-extern global_node_struct *global_nodes;                   // Keeps track of the list of nodes
-extern edge_struct *edge_hash_table[HASH_SIZE];            // Create the edge hash table
-extern path_collection_struct *path_hash_table[HASH_SIZE]; // Create the path hash table
-
 #endif
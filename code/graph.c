@@ -1,10 +1,13 @@
 #include <string.h> // strncpy
 #include <stdlib.h> // malloc
 #include <stdio.h>  // printf
+#include <math.h>   // isnan
+#include <stdbool.h> // true, false
 
 #include "global.h"
 #include "metrics.h"
 #include "graph.h"
+#include "snapshot.h"
 
 /*************************
  * Global Node Functions *
@@ -28,6 +31,7 @@ global_node_struct *create_global_node(char *name, char *description) {
   }
   strncpy(new_node->name, name, NAME_MAX_LENGTH);
   strncpy(new_node->description, description, NAME_MAX_LENGTH);
+  new_node->removed = false;
   new_node->next = NULL;
   return new_node;
 }
@@ -36,18 +40,82 @@ global_node_struct *create_global_node(char *name, char *description) {
  * get_global_node_name_by_index - Lookup the name of a node based on the index number
  *
  * Arguments:
- *   index - Index number of the node name
+ *   index - Index number (node id) of the node name
  *
  * Returns a pointer to the name of the node at the given index.  Returns NULL if the
  * index number is not found.
  */
-char *get_global_node_name_by_index(int index) {
-  int curnum = 0;
-  for (global_node_struct *curnode=global_nodes; curnode != NULL; curnode=curnode->next) {
-    if (index == curnum) return (curnode->name);
-    curnum++;
+char *get_global_node_name_by_index(pathopt_ctx *ctx, int index) {
+  if (index < 0 || index >= ctx->global_node_total) return NULL;
+  return ctx->global_node_table[index]->name;
+}
+
+/*
+ * get_global_node_id - Lookup the id of a node based on its name
+ *
+ * Arguments:
+ *   name - Node name
+ *
+ * Returns the dense id assigned to the node when it was added.  Returns ERROR
+ * if the name is not found.
+ */
+int get_global_node_id(pathopt_ctx *ctx, char *name) {
+  return get_global_node_id_span(ctx, name, strnlen(name, NAME_MAX_LENGTH));
+}
+
+/*
+ * get_global_node_id_span - Lookup the id of a node from a name that is not terminated
+ *
+ * Arguments:
+ *   name   - Start of the node name
+ *   length - Number of characters in the name
+ *
+ * Same as get_global_node_id, for a name inside a larger buffer (such as a
+ * mapped input file), so the name does not have to be copied out first.
+ * Like the stored names, only the first NAME_MAX_LENGTH characters count.
+ */
+int get_global_node_id_span(pathopt_ctx *ctx, const char *name, int length) {
+  if (ctx->node_hash_capacity == 0) return ERROR;
+  if (length > NAME_MAX_LENGTH) length = NAME_MAX_LENGTH;
+  unsigned int mask = ctx->node_hash_capacity - 1;
+  // Linear probing until the name or an empty slot is found
+  for(unsigned int slot = global_node_hash_span(name, length) & mask; ctx->node_hash_table[slot] != ERROR; slot = (slot + 1) & mask) {
+    char *other = ctx->global_node_table[ctx->node_hash_table[slot]]->name;
+    if (strncmp(other, name, length) == 0 && (length == NAME_MAX_LENGTH || other[length] == 0)) return ctx->node_hash_table[slot];
   }
-  return NULL;
+  return ERROR;
+}
+
+/*
+ * insert_global_node_hash - Puts a node id in the name hash table
+ *
+ * Arguments:
+ *   id - Id of a node in global_node_table that is not in the hash yet
+ *
+ * Doubles the table (and rehashes) once it would be more than half full.
+ */
+void insert_global_node_hash(pathopt_ctx *ctx, int id) {
+  if ((unsigned int)(ctx->global_node_total * 2) > ctx->node_hash_capacity) {
+    unsigned int capacity = (ctx->node_hash_capacity == 0) ? (HASH_INITIAL_SIZE) : (ctx->node_hash_capacity * 2);
+    int *new_table = malloc(capacity * sizeof(int));
+    if (new_table == NULL) {
+      printf("Memory Allocation failed: insert_global_node_hash(%u)\n", capacity);
+      exit(1);
+    }
+    for(unsigned int i=0; i < capacity; i++) new_table[i] = ERROR;
+    int *old_table = ctx->node_hash_table;
+    ctx->node_hash_table = new_table;
+    ctx->node_hash_capacity = capacity;
+    // Every node except the new one (and removed ones) is already hashed
+    for(int other=0; other < ctx->global_node_total; other++) {
+      if (other != id && !ctx->global_node_table[other]->removed) insert_global_node_hash(ctx, other);
+    }
+    free(old_table);
+  }
+  unsigned int mask = ctx->node_hash_capacity - 1;
+  unsigned int slot = global_node_hash_key(ctx->global_node_table[id]->name) & mask;
+  while (ctx->node_hash_table[slot] != ERROR) slot = (slot + 1) & mask;
+  ctx->node_hash_table[slot] = id;
 }
 
 /*
@@ -57,29 +125,112 @@ char *get_global_node_name_by_index(int index) {
  *   name        - Node name
  *   description - Node description
  *
- * Creates and inserts a global node.
+ * Creates and inserts a global node.  The node is given the next dense id
+ * and is entered into the id table and the name hash table.
  */
-void add_global_node(char *name, char *description) {
+void add_global_node(pathopt_ctx *ctx, char *name, char *description) {
+  // Verify it does not already exist
+  if (get_global_node_id(ctx, name) != ERROR) {
+    printf("Global Node \"%s\" already exists!\n", name);
+    return;
+  }
   // Create new node
   global_node_struct *new_node = create_global_node(name, description);
-  new_node->next = global_nodes;
-  global_nodes = new_node;
+  new_node->next = ctx->global_nodes;
+  ctx->global_nodes = new_node;
+
+  // Grow the id table when it is full (capacity is always a power of two)
+  if ((ctx->global_node_total & (ctx->global_node_total - 1)) == 0) {
+    int capacity = (ctx->global_node_total == 0) ? (1) : (ctx->global_node_total * 2);
+    global_node_struct **new_table = realloc(ctx->global_node_table, capacity * sizeof(global_node_struct *));
+    if (new_table == NULL) {
+      printf("Memory Allocation failed: add_global_node('%s', '%s')\n", name, description);
+      exit(1);
+    }
+    ctx->global_node_table = new_table;
+  }
+  new_node->id = ctx->global_node_total;
+  ctx->global_node_table[ctx->global_node_total++] = new_node;
+
+  // Add to the name hash table
+  insert_global_node_hash(ctx, new_node->id);
+}
+
+/*
+ * remove_global_node_hash - Takes a node id out of the name hash table
+ *
+ * Arguments:
+ *   id - Id of a node that is in the hash
+ *
+ * Uses backward shift deletion: the entries after the emptied slot are
+ * moved back when their home slot allows it, so linear probing never
+ * stops early at the hole.
+ */
+void remove_global_node_hash(pathopt_ctx *ctx, int id) {
+  unsigned int mask = ctx->node_hash_capacity - 1;
+  unsigned int hole = global_node_hash_key(ctx->global_node_table[id]->name) & mask;
+  while (ctx->node_hash_table[hole] != id) hole = (hole + 1) & mask;
+  for(unsigned int slot = (hole + 1) & mask; ctx->node_hash_table[slot] != ERROR; slot = (slot + 1) & mask) {
+    unsigned int home = global_node_hash_key(ctx->global_node_table[ctx->node_hash_table[slot]]->name) & mask;
+    // Move the entry back unless its home slot lies after the hole
+    if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+      ctx->node_hash_table[hole] = ctx->node_hash_table[slot];
+      hole = slot;
+    }
+  }
+  ctx->node_hash_table[hole] = ERROR;
+}
+
+/*
+ * remove_global_node - Removes a node and its edges
+ *
+ * Arguments:
+ *   id - Id of the node to remove
+ *
+ * Removes every edge into or out of the node and takes its name out of the
+ * hash, so it can no longer be looked up (the name may be added again as a
+ * new node).  Ids are dense indexes into the path table and the paths, so
+ * the node stays in the id table marked as removed and its id is not
+ * reused.  The CSR index must be rebuilt afterwards.  Returns ERROR if
+ * there is no such node.
+ */
+int remove_global_node(pathopt_ctx *ctx, int id) {
+  if (id < 0 || id >= ctx->global_node_total || ctx->global_node_table[id]->removed) return ERROR;
+
+  // Remove the edges, restarting at a slot whenever an entry shifts into it
+  for(unsigned int i=0; i < ctx->edge_hash_capacity; i++) {
+    while (ctx->edge_hash_table[i].srcid != ERROR && (ctx->edge_hash_table[i].srcid == id || ctx->edge_hash_table[i].dstid == id)) {
+      remove_global_edge(ctx, ctx->edge_hash_table[i].srcid, ctx->edge_hash_table[i].dstid);
+    }
+  }
+
+  remove_global_node_hash(ctx, id);
+  ctx->global_node_table[id]->removed = true;
+  return 0;
 }
 
 /*
  * free_global_nodes - Free all global nodes in the linked list
  *
- * Frees each node in the global_nodes linked list.
+ * Frees each node in the global_nodes linked list along with the id
+ * and name lookup tables.
  */
-void free_global_nodes() {
+void free_global_nodes(pathopt_ctx *ctx) {
   // Current node
   global_node_struct *temp;
   // Remove nodes
-  while (global_nodes != NULL) {
-    temp = global_nodes;
-    global_nodes = global_nodes->next;
+  while (ctx->global_nodes != NULL) {
+    temp = ctx->global_nodes;
+    ctx->global_nodes = ctx->global_nodes->next;
     free(temp);
   }
+  // Remove lookup tables
+  free(ctx->global_node_table);
+  free(ctx->node_hash_table);
+  ctx->global_node_table = NULL;
+  ctx->global_node_total = 0;
+  ctx->node_hash_table = NULL;
+  ctx->node_hash_capacity = 0;
 }
 
 /*
@@ -87,42 +238,41 @@ void free_global_nodes() {
  *
  * Returns the number of global nodes.
  */
-unsigned int global_node_count() {
-  unsigned int total = 0;
-  global_node_struct *current;
-  current = global_nodes;
-  while(current != NULL) {
-    total++;
-    current = current->next;
-  }
-  return total;
+unsigned int global_node_count(pathopt_ctx *ctx) {
+  return ctx->global_node_total;
 }
 
-/************************
- * Local Node Functions *
- ************************/
+/*
+ * global_node_hash_key - Creates a node hash using the name as key
+ *
+ * Arguments:
+ *   name - Node name
+ *
+ * 32-bit FNV-1a hash of the name.  Callers mask it down to their table size,
+ * so every bit of the result depends on every character.
+ */
+unsigned int global_node_hash_key(const char *name) {
+  return global_node_hash_span(name, strnlen(name, NAME_MAX_LENGTH));
+}
 
 /*
- * create_node - Create a local node for the linked list
+ * global_node_hash_span - Creates a node hash from a name that is not terminated
  *
  * Arguments:
- *   name - Name of node to create
+ *   name   - Start of the node name
+ *   length - Number of characters in the name (at most NAME_MAX_LENGTH)
  *
- * Allocates the memory for the struct, assigns values and returns
- * the completed struct.
+ * The FNV-1a hash behind global_node_hash_key.
  */
-node_struct *create_node(char *name) {
-  node_struct *new_node = malloc(sizeof(node_struct));
-  if (new_node == NULL) {
-    printf("Memory Allocation failed: create_node('%s')\n", name);
-    exit(1);
+unsigned int global_node_hash_span(const char *name, int length) {
+  unsigned int hash = 2166136261u;
+  for(int i=0; i < length; i++) {
+    hash ^= (unsigned char)name[i];
+    hash *= 16777619u;
   }
-  strncpy(new_node->name, name, NAME_MAX_LENGTH);
-  new_node->next = NULL;
-  return new_node;
+  return hash;
 }
 
-
 /*************************
  * Global Edge Functions *
  *************************/
@@ -130,27 +280,87 @@ node_struct *create_node(char *name) {
 /*
  * init_global_edge_table - initializes memory for hash table
  *
- * hash table is initialized with size HASH_SIZE
+ * The open addressing table starts empty and is allocated with
+ * HASH_INITIAL_SIZE slots on the first insert.
  */
-void init_global_edge_table() {
-  for(int i=0; i < HASH_SIZE; i++) edge_hash_table[i] = NULL;
+void init_global_edge_table(pathopt_ctx *ctx) {
+  ctx->edge_hash_table = NULL;
+  ctx->edge_hash_capacity = 0;
+  ctx->edge_hash_used = 0;
 }
 
 /*
  * free_global_edge_table - frees all mem allocations of hash table
  *
- * frees all data in hash table of size HASH_SIZE, including item
- * connected with linked lists
+ * frees the metric vectors of every edge (except those in a loaded snapshot)
+ * and then the table itself
  */
-void free_global_edge_table() {
-  edge_struct *temp;
-  for(int i=0; i < HASH_SIZE; i++) {
-    while(edge_hash_table[i] != NULL) {
-      temp = edge_hash_table[i];
-      edge_hash_table[i] = temp->next;
-      free(temp);
-    }
+void free_global_edge_table(pathopt_ctx *ctx) {
+  for(unsigned int i=0; i < ctx->edge_hash_capacity; i++) {
+    if (ctx->edge_hash_table[i].srcid != ERROR && !snapshot_owns(ctx, ctx->edge_hash_table[i].metrics)) delete_metrics(ctx->edge_hash_table[i].metrics);
   }
+  free(ctx->edge_hash_table);
+  init_global_edge_table(ctx);
+}
+
+/*
+ * global_edge_hash_slot - Finds the slot of an edge in the hash table
+ *
+ * Arguments:
+ *   srcid - Source node id
+ *   dstid - Destination node id
+ *
+ * Returns the slot holding the edge, or the empty slot where it belongs
+ * when it is not in the table.  The table must have been allocated.
+ */
+unsigned int global_edge_hash_slot(pathopt_ctx *ctx, int srcid, int dstid) {
+  unsigned int mask = ctx->edge_hash_capacity - 1;
+  unsigned int slot = global_edge_hash_key(srcid, dstid) & mask;
+  while (ctx->edge_hash_table[slot].srcid != ERROR) {
+    if (ctx->edge_hash_table[slot].srcid == srcid && ctx->edge_hash_table[slot].dstid == dstid) break;
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+/*
+ * grow_global_edge_table - Doubles the edge hash table
+ *
+ * Allocates a table twice the size (or HASH_INITIAL_SIZE for the first one)
+ * and moves every edge into it.  Pointers to edges in the old table are no
+ * longer valid afterwards.
+ */
+void grow_global_edge_table(pathopt_ctx *ctx) {
+  edge_struct *old_table = ctx->edge_hash_table;
+  unsigned int old_capacity = ctx->edge_hash_capacity;
+  unsigned int capacity = (old_capacity == 0) ? (HASH_INITIAL_SIZE) : (old_capacity * 2);
+
+  ctx->edge_hash_table = malloc(capacity * sizeof(edge_struct));
+  if (ctx->edge_hash_table == NULL) {
+    printf("Memory Allocation failed: grow_global_edge_table(%u)\n", capacity);
+    exit(1);
+  }
+  ctx->edge_hash_capacity = capacity;
+  for(unsigned int i=0; i < capacity; i++) ctx->edge_hash_table[i].srcid = ERROR;
+
+  for(unsigned int i=0; i < old_capacity; i++) {
+    if (old_table[i].srcid == ERROR) continue;
+    ctx->edge_hash_table[global_edge_hash_slot(ctx, old_table[i].srcid, old_table[i].dstid)] = old_table[i];
+  }
+  free(old_table);
+}
+
+/*
+ * reserve_global_edge_table - Makes room for more edges in the hash table
+ *
+ * Arguments:
+ *   edges - Number of edges the table should hold
+ *
+ * Grows the table up front so that adding that many edges in total does not
+ * rehash along the way.
+ */
+void reserve_global_edge_table(pathopt_ctx *ctx, unsigned int edges) {
+  while (edges * 2 > ctx->edge_hash_capacity) grow_global_edge_table(ctx);
 }
 
 /*
@@ -159,126 +369,261 @@ void free_global_edge_table() {
  * Arguments:
  *   srcname - Source node name (should match a node name
  *   dstname - Destination name (same as above)
- *   metric  - Metrics for the edge (linked list)
+ *   metric  - Metric vector for the edge
  *
- * Adds an edge node and sets the srcname, dstname, and metrics.  It puts
- * the new edge node in the global linked list/hash.
+ * Resolves the node names to ids, then stores the edge with its srcid, dstid,
+ * and metrics in the edge hash table, growing it when it gets more than half
+ * full.  Edges that reference unknown nodes are reported and dropped.
  */
-void add_global_edge(char *srcname, char *dstname, struct metric_struct *metric) {
-  /* this function's input arguments metric_struct *metric
-   * then it will create and insert the edge into the hashmap by calling helper functions:
-   * edge_struct *create_global_edge(char *srcname, char *dstname, struct metric_struct *metric) {
-   * unsigned int global_edge_hash(const char* srcname, const char* dstname, int size);
-   */
+void add_global_edge(pathopt_ctx *ctx, char *srcname, char *dstname, double *metric) {
   if (DEBUG) {
     printf("add_global_edge('%s', '%s', metrics)\n", srcname, dstname);
-    display_metrics(stdout, " - metrics: ", metric, "\n"); // See metrics.c .h
+    display_metrics(ctx, stdout, " - metrics: ", metric, "\n"); // See metrics.c .h
   }
 
-  edge_struct *new_edge = create_global_edge(srcname, dstname, metric);
-  unsigned int key = global_edge_hash_key(srcname, dstname);
-
-  // Insert the edge into the edge_hash_table
-  if (edge_hash_table[key] == NULL) {
-    // Insert into empty list
-    edge_hash_table[key] = new_edge;
-  } else {
-    // Add to hash table stack
-    new_edge->next = edge_hash_table[key];
-    edge_hash_table[key] = new_edge;
+  int srcid = get_global_node_id(ctx, srcname);
+  int dstid = get_global_node_id(ctx, dstname);
+  if (srcid == ERROR || dstid == ERROR) {
+    printf("Error: Edge \"%s\" -> \"%s\" references an unknown node\n", srcname, dstname);
+    delete_metrics(metric);
+    return;
   }
+  add_global_edge_ids(ctx, srcid, dstid, metric);
 }
 
 /*
- * get_global_edge - Returns a pointer to the requested edge
+ * add_global_edge_ids - Adds an edge between known node ids to the hash
  *
  * Arguments:
- *   srcname - Source node name (should match a node name)
- *   dstname - Destination name (same as above)
+ *   srcid  - Source node id
+ *   dstid  - Destination node id
+ *   metric - Metric vector for the edge (the edge takes ownership)
  *
- * Looks up the edge in the edge edge_hash_table and returns a pointer to the active edge node.
+ * The part of add_global_edge after the names are resolved, for callers
+ * that already have the ids.
  */
-edge_struct *get_global_edge(char *srcname, char *dstname) {
-  unsigned int key = global_edge_hash_key(srcname, dstname);
-
-  for(edge_struct *current = edge_hash_table[key]; current != NULL; current = current->next) {
-    if (strncmp(current->srcname, srcname, NAME_MAX_LENGTH) == 0 &&
-	strncmp(current->dstname, dstname, NAME_MAX_LENGTH) == 0) return current;
+void add_global_edge_ids(pathopt_ctx *ctx, int srcid, int dstid, double *metric) {
+  // Replace the metrics when the edge is listed again
+  edge_struct *old_edge = get_global_edge(ctx, srcid, dstid);
+  if (old_edge != NULL) {
+    if (!snapshot_owns(ctx, old_edge->metrics)) delete_metrics(old_edge->metrics);
+    old_edge->metrics = metric;
+    return;
   }
 
-  return NULL;
+  // Keep the load factor at or below one half
+  if ((ctx->edge_hash_used + 1) * 2 > ctx->edge_hash_capacity) grow_global_edge_table(ctx);
+
+  // Insert the edge into the edge_hash_table
+  edge_struct *new_edge = &ctx->edge_hash_table[global_edge_hash_slot(ctx, srcid, dstid)];
+  new_edge->srcid = srcid;
+  new_edge->dstid = dstid;
+  new_edge->metrics = metric;
+  ctx->edge_hash_used++;
 }
 
+/*
+ * update_global_edge - Changes the metrics of an existing edge
+ *
+ * Arguments:
+ *   srcid  - Source node id
+ *   dstid  - Destination node id
+ *   values - New metric values by ordinal, as written in the input file
+ *            (NAN leaves that metric unchanged)
+ *
+ * Stores the new values in the edge hash table and in the edge's row of the
+ * CSR index.  Returns 1 if any metric changed, 0 if none did or ERROR if
+ * there is no such edge.
+ */
+int update_global_edge(pathopt_ctx *ctx, int srcid, int dstid, double *values) {
+  edge_struct *edge = get_global_edge(ctx, srcid, dstid);
+  int index = global_adjacency_index(ctx, srcid, dstid);
+  if (edge == NULL || index == ERROR) return ERROR;
+
+  int changed = false;
+  for(int i=0; i < ctx->global_metric_total; i++) {
+    if (isnan(values[i])) continue;
+    double value = values[i] * ctx->global_metric_table[i]->sign;
+    if (edge->metrics[i] == value) continue;
+    edge->metrics[i] = value;
+    ctx->adj_metrics[index * ctx->global_metric_total + i] = value;
+    changed = true;
+  }
+  if (DEBUG && changed) display_metrics(ctx, stdout, "update_global_edge: ", edge->metrics, "\n");
+  return changed;
+}
 
 /*
- * create_global_edge - Creates an edge node with metrics to the global list/hash
+ * remove_global_edge - Removes an edge from the edge hash table
  *
  * Arguments:
- *   srcname - Source node name (should match a node name)
- *   dstname - Destination name (same as above)
- *   metric  - Metrics for the edge (linked list)
+ *   srcid - Source node id
+ *   dstid - Destination node id
  *
- * Creates an edge node and sets the srcname, dstname, and metrics.  It puts
- * the new edge node in the global linked list/hash.
+ * Frees the edge's metrics and closes the gap with backward shift deletion
+ * (see remove_global_node_hash).  The CSR index must be rebuilt afterwards.
+ * Returns ERROR if there is no such edge.
  */
-edge_struct *create_global_edge(char *srcname, char *dstname, struct metric_struct *metric) {
-  // allocate mem for edge
-  edge_struct *new_edge = malloc(sizeof(edge_struct));
-  if (new_edge == NULL) {
-    printf("Memory Allocation failed: create_global_edge('%s', '%s', %s)\n", srcname, dstname, "metric");
-    exit(1);
+int remove_global_edge(pathopt_ctx *ctx, int srcid, int dstid) {
+  if (get_global_edge(ctx, srcid, dstid) == NULL) return ERROR;
+  unsigned int mask = ctx->edge_hash_capacity - 1;
+  unsigned int hole = global_edge_hash_slot(ctx, srcid, dstid);
+  if (!snapshot_owns(ctx, ctx->edge_hash_table[hole].metrics)) delete_metrics(ctx->edge_hash_table[hole].metrics);
+  for(unsigned int slot = (hole + 1) & mask; ctx->edge_hash_table[slot].srcid != ERROR; slot = (slot + 1) & mask) {
+    unsigned int home = global_edge_hash_key(ctx->edge_hash_table[slot].srcid, ctx->edge_hash_table[slot].dstid) & mask;
+    // Move the entry back unless its home slot lies after the hole
+    if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+      ctx->edge_hash_table[hole] = ctx->edge_hash_table[slot];
+      hole = slot;
+    }
   }
-  // Store source and destination for edge_struct
-  strncpy(new_edge->srcname, srcname, NAME_MAX_LENGTH);
-  strncpy(new_edge->dstname, dstname, NAME_MAX_LENGTH);
-  new_edge->next = NULL;
+  ctx->edge_hash_table[hole].srcid = ERROR;
+  ctx->edge_hash_used--;
+  return 0;
+}
 
-  // store metric ptr with edge
-  new_edge->metrics = metric;
-  return new_edge;
+/*
+ * get_global_edge - Returns a pointer to the requested edge
+ *
+ * Arguments:
+ *   srcid - Source node id
+ *   dstid - Destination node id
+ *
+ * Looks up the edge in the edge edge_hash_table and returns a pointer to the active edge node,
+ * or NULL if there is no such edge.  The pointer is only valid until the next edge is added.
+ */
+edge_struct *get_global_edge(pathopt_ctx *ctx, int srcid, int dstid) {
+  if (ctx->edge_hash_capacity == 0) return NULL;
+  edge_struct *edge = &ctx->edge_hash_table[global_edge_hash_slot(ctx, srcid, dstid)];
+  return (edge->srcid == ERROR) ? (NULL) : (edge);
 }
 
 /*
  * global_edge_hash_key - Creates a edge hash using src and dst as key
  *
  * Arguments:
- *   srcname - Source node name (should match a node name)
- *   dstname - Destination name (same as above)
+ *   srcid - Source node id
+ *   dstid - Destination node id
  *
- * Creates a key for edge edge_hash_table to search and add edge_struct nodes
+ * Mixes the (srcid, dstid) pair with the 64-bit finalizer from MurmurHash3
+ * so that neighboring ids land far apart.  Callers mask it down to their
+ * table size.
  */
-unsigned int global_edge_hash_key(const char *srcname, const char *dstname) {
-    unsigned int hash = 0;
+unsigned int global_edge_hash_key(int srcid, int dstid) {
+  unsigned long long hash = ((unsigned long long)(unsigned int)srcid << 32) | (unsigned int)dstid;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return (unsigned int)hash;
+}
 
-    // Add source node name to hash
-    for(int i=0; i < NAME_MAX_LENGTH; i++) {
-      if (srcname[i] == 0) break;
-      hash += ((int)srcname[i] * (i + 1));
-    }
+/*
+ * global_edge_hash_count - Counts the number of edges in the hash
+ *
+ * Returns the number of edges in the hash table.
+ */
+unsigned int global_edge_hash_count(pathopt_ctx *ctx) {
+  return ctx->edge_hash_used;
+}
 
-    // Add destination node name to hash
-    for(int i=0; i < NAME_MAX_LENGTH; i++) {
-      if (dstname[i] == 0) break;
-      hash += ((int)dstname[i] * (i + 1));
-    }
+/******************************
+ * Global Adjacency Functions *
+ ******************************/
+
+/*
+ * build_global_adjacency - Builds the CSR out-neighbor index from the edge hash
+ *
+ * Counts the out-degree of every node, turns the counts into offsets and
+ * then places each edge's destination id and a copy of its metric vector
+ * in its source node's range.  Any previous index is freed first, so this
+ * can be called again after the edges change.  Edges within a node's range
+ * are sorted by destination id so the index does not depend on hash order;
+ * two counting sort passes (by destination, then by source) keep the build
+ * linear in the number of edges.
+ */
+void build_global_adjacency(pathopt_ctx *ctx) {
+  int nodes = ctx->global_node_total;
+  int edges = global_edge_hash_count(ctx);
+
+  free_global_adjacency(ctx);
+  ctx->adj_offsets = calloc(nodes + 1, sizeof(int));
+  ctx->adj_targets = malloc((edges > 0 ? edges : 1) * sizeof(int));
+  ctx->adj_metrics = malloc((edges > 0 ? edges : 1) * (ctx->global_metric_total > 0 ? ctx->global_metric_total : 1) * sizeof(double));
+  if (ctx->adj_offsets == NULL || ctx->adj_targets == NULL || ctx->adj_metrics == NULL) {
+    printf("Memory Allocation failed: build_global_adjacency(%d nodes, %d edges)\n", nodes, edges);
+    exit(1);
+  }
 
-    return (hash % HASH_SIZE);
+  // Count out-degrees, then prefix sum into offsets
+  for(unsigned int i=0; i < ctx->edge_hash_capacity; i++) {
+    if (ctx->edge_hash_table[i].srcid != ERROR) ctx->adj_offsets[ctx->edge_hash_table[i].srcid + 1]++;
+  }
+  for(int i=0; i < nodes; i++) ctx->adj_offsets[i + 1] += ctx->adj_offsets[i];
+
+  // Order the edges by destination id with a counting sort
+  int *fill = calloc(nodes + 1, sizeof(int));
+  edge_struct **by_dst = malloc((edges > 0 ? edges : 1) * sizeof(edge_struct *));
+  if (fill == NULL || by_dst == NULL) {
+    printf("Memory Allocation failed: build_global_adjacency(%d nodes, %d edges)\n", nodes, edges);
+    exit(1);
+  }
+  for(unsigned int i=0; i < ctx->edge_hash_capacity; i++) {
+    if (ctx->edge_hash_table[i].srcid != ERROR) fill[ctx->edge_hash_table[i].dstid + 1]++;
+  }
+  for(int i=0; i < nodes; i++) fill[i + 1] += fill[i];
+  for(unsigned int i=0; i < ctx->edge_hash_capacity; i++) {
+    if (ctx->edge_hash_table[i].srcid != ERROR) by_dst[fill[ctx->edge_hash_table[i].dstid]++] = &ctx->edge_hash_table[i];
+  }
+
+  // Then place them by source in that order, so each range is sorted by destination
+  for(int i=0; i < nodes; i++) fill[i] = ctx->adj_offsets[i];
+  for(int i=0; i < edges; i++) {
+    edge_struct *current = by_dst[i];
+    int pos = fill[current->srcid]++;
+    ctx->adj_targets[pos] = current->dstid;
+    copy_metrics(ctx, ctx->adj_metrics + pos * ctx->global_metric_total, current->metrics);
+  }
+  free(by_dst);
+  free(fill);
+
+  if (DEBUG) printf("build_global_adjacency: %d nodes, %d edges\n", nodes, edges);
 }
 
 /*
- * global_edge_hash_count - Counts the number of edges in the hash
+ * free_global_adjacency - Frees the CSR out-neighbor index
  *
- * Returns the number of edges in the hash table.
+ * The edge hash table keeps its own metric vectors, which are not freed here.
+ * Arrays that point into a loaded snapshot are left alone.
  */
-unsigned int global_edge_hash_count() {
-  unsigned int total = 0;
-  edge_struct *current;
-  for(int i=0; i < HASH_SIZE; i++) {
-    current = edge_hash_table[i];
-    while(current != NULL) {
-      total++;
-      current = current->next;
-    }
+void free_global_adjacency(pathopt_ctx *ctx) {
+  if (!snapshot_owns(ctx, ctx->adj_offsets)) free(ctx->adj_offsets);
+  if (!snapshot_owns(ctx, ctx->adj_targets)) free(ctx->adj_targets);
+  if (!snapshot_owns(ctx, ctx->adj_metrics)) free(ctx->adj_metrics);
+  ctx->adj_offsets = NULL;
+  ctx->adj_targets = NULL;
+  ctx->adj_metrics = NULL;
+}
+
+/*
+ * global_adjacency_index - Finds an edge in the CSR index
+ *
+ * Arguments:
+ *   srcid - Source node id
+ *   dstid - Destination node id
+ *
+ * Binary searches the source's range, which is sorted by destination id.
+ * Returns the edge's index into adj_targets (its metric row is that index
+ * times global_metric_total) or ERROR if there is no such edge.
+ */
+int global_adjacency_index(pathopt_ctx *ctx, int srcid, int dstid) {
+  if (ctx->adj_offsets == NULL || srcid < 0 || srcid >= ctx->global_node_total) return ERROR;
+  int low = ctx->adj_offsets[srcid], high = ctx->adj_offsets[srcid + 1];
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (ctx->adj_targets[mid] < dstid) low = mid + 1;
+    else high = mid;
   }
-  return total;
+  return (low < ctx->adj_offsets[srcid + 1] && ctx->adj_targets[low] == dstid) ? (low) : (ERROR);
 }
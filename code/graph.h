@@ -6,27 +6,41 @@
  *************************/
 
 global_node_struct *create_global_node(char *name, char *description);
-char *get_global_node_name_by_index(int index);
-void add_global_node(char *name, char *description);
-void free_global_nodes();
-unsigned int global_node_count();
-
-/************************
- * Local Node Functions *
- ************************/
-
-node_struct *create_node(char *name);
+char *get_global_node_name_by_index(pathopt_ctx *ctx, int index);
+int get_global_node_id(pathopt_ctx *ctx, char *name);
+int get_global_node_id_span(pathopt_ctx *ctx, const char *name, int length);
+void insert_global_node_hash(pathopt_ctx *ctx, int id);
+void add_global_node(pathopt_ctx *ctx, char *name, char *description);
+void remove_global_node_hash(pathopt_ctx *ctx, int id);
+int remove_global_node(pathopt_ctx *ctx, int id);
+void free_global_nodes(pathopt_ctx *ctx);
+unsigned int global_node_count(pathopt_ctx *ctx);
+unsigned int global_node_hash_key(const char *name);
+unsigned int global_node_hash_span(const char *name, int length);
 
 /*************************
  * Global Edge Functions *
  *************************/
 
-void add_global_edge(char *srcname, char *dstname, struct metric_struct *metric);
-edge_struct *get_global_edge(char *srcname, char *dstname);
-edge_struct *create_global_edge(char *srcname, char *dstname, struct metric_struct *metric);
-unsigned int global_edge_hash_key(const char* srcname, const char* dstname);
-void init_global_edge_table();
-void free_global_edge_table();
-unsigned int global_edge_hash_count();
+void add_global_edge(pathopt_ctx *ctx, char *srcname, char *dstname, double *metric);
+void add_global_edge_ids(pathopt_ctx *ctx, int srcid, int dstid, double *metric);
+int update_global_edge(pathopt_ctx *ctx, int srcid, int dstid, double *values);
+int remove_global_edge(pathopt_ctx *ctx, int srcid, int dstid);
+edge_struct *get_global_edge(pathopt_ctx *ctx, int srcid, int dstid);
+unsigned int global_edge_hash_key(int srcid, int dstid);
+unsigned int global_edge_hash_slot(pathopt_ctx *ctx, int srcid, int dstid);
+void grow_global_edge_table(pathopt_ctx *ctx);
+void reserve_global_edge_table(pathopt_ctx *ctx, unsigned int edges);
+void init_global_edge_table(pathopt_ctx *ctx);
+void free_global_edge_table(pathopt_ctx *ctx);
+unsigned int global_edge_hash_count(pathopt_ctx *ctx);
+
+/******************************
+ * Global Adjacency Functions *
+ ******************************/
+
+void build_global_adjacency(pathopt_ctx *ctx);
+void free_global_adjacency(pathopt_ctx *ctx);
+int global_adjacency_index(pathopt_ctx *ctx, int srcid, int dstid);
 
 #endif
@@ -0,0 +1,98 @@
+#include <stdlib.h>  // malloc, free
+#include <stdbool.h> // true
+#include <stdio.h>   // printf
+
+#include "global.h"
+#include "paths.h"
+#include "heap.h"
+
+/***********************
+ * Path Heap Functions *
+ ***********************/
+
+/*
+ * heap_init - Initializes an empty path heap
+ *
+ * Arguments:
+ *   heap - Heap to initialize
+ */
+void heap_init(path_heap_struct *heap) {
+  heap->items = NULL;
+  heap->count = 0;
+  heap->capacity = 0;
+}
+
+/*
+ * heap_push - Adds a path to the heap
+ *
+ * Arguments:
+ *   heap - Heap to add to
+ *   path - Path to add
+ *
+ * The heap takes its own reference to the path, which heap_pop hands
+ * over to the caller.
+ */
+void heap_push(pathopt_ctx *ctx, path_heap_struct *heap, path_struct *path) {
+  // Grow when full
+  if (heap->count == heap->capacity) {
+    int capacity = (heap->capacity == 0) ? (64) : (heap->capacity * 2);
+    path_struct **items = realloc(heap->items, capacity * sizeof(path_struct *));
+    if (items == NULL) {
+      printf("Memory Allocation failed: heap_push(%d)\n", capacity);
+      exit(1);
+    }
+    heap->items = items;
+    heap->capacity = capacity;
+  }
+  path->refs++;
+
+  // Sift up
+  int pos = heap->count++;
+  while (pos > 0) {
+    int parent = (pos - 1) / 2;
+    if (compare_paths_lex(ctx, heap->items[parent], path) <= 0) break;
+    heap->items[pos] = heap->items[parent];
+    pos = parent;
+  }
+  heap->items[pos] = path;
+}
+
+/*
+ * heap_pop - Removes the lexicographically smallest path from the heap
+ *
+ * Arguments:
+ *   heap - Heap to remove from
+ *
+ * Returns the path (the caller now owns the heap's reference and must
+ * delete_path it), or NULL when the heap is empty.
+ */
+path_struct *heap_pop(pathopt_ctx *ctx, path_heap_struct *heap) {
+  if (heap->count == 0) return NULL;
+  path_struct *top = heap->items[0];
+  path_struct *last = heap->items[--heap->count];
+
+  // Sift the last item down from the top
+  int pos = 0;
+  while (true) {
+    int child = pos * 2 + 1;
+    if (child >= heap->count) break;
+    if (child + 1 < heap->count && compare_paths_lex(ctx, heap->items[child + 1], heap->items[child]) < 0) child++;
+    if (compare_paths_lex(ctx, last, heap->items[child]) <= 0) break;
+    heap->items[pos] = heap->items[child];
+    pos = child;
+  }
+  if (heap->count > 0) heap->items[pos] = last;
+  return top;
+}
+
+/*
+ * heap_free - Frees the heap and releases any paths still in it
+ *
+ * Arguments:
+ *   heap - Heap to free
+ */
+void heap_free(pathopt_ctx *ctx, path_heap_struct *heap) {
+  for(int i=0; i < heap->count; i++) delete_path(ctx, heap->items[i]);
+  free(heap->items);
+  heap_init(heap);
+}
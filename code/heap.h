@@ -0,0 +1,13 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+/***********************
+ * Path Heap Functions *
+ ***********************/
+
+void heap_init(path_heap_struct *heap);
+void heap_push(pathopt_ctx *ctx, path_heap_struct *heap, path_struct *path);
+path_struct *heap_pop(pathopt_ctx *ctx, path_heap_struct *heap);
+void heap_free(pathopt_ctx *ctx, path_heap_struct *heap);
+
+#endif
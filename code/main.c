@@ -1,37 +1,131 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
 
 #include "global.h"
 #include "metrics.h"
 #include "graph.h"
 #include "parser.h"
 #include "paths.h"
+#include "snapshot.h"
+#include "results.h"
+#include "stats.h"
+
+/*
+ * usage - Prints the command line usage and exits
+ *
+ * Arguments:
+ *   program - Name the program was run as
+ */
+void usage(char *program) {
+  printf("Usage: %s [-e rounds|label] [-p mmap|stream] [-j threads] [-b results] [-s source [-d destination]] [--stats] <input file or snapshot>\n", program);
+  printf("       %s compile [-p mmap|stream] [-j threads] [--stats] <input file> <snapshot>\n", program);
+  printf("  -e engine  Optimization engine (default: label)\n");
+  printf("  -p parser  Input parser (default: mmap)\n");
+  printf("  -j N       Parse edges and optimize sources on N threads (default: 1)\n");
+  printf("  -b file    Write the results to a binary result file instead of stdout\n");
+  printf("  -s node    Only optimize the paths from this source\n");
+  printf("  -d node    Only optimize the paths from the source to this destination\n");
+  printf("  --stats    Count hot path events and report them with the phase timings on stderr\n");
+  exit(1);
+}
 
 int main(int argc, char *argv[]) {
-  global_initialize(); // Initialize global variables
+  pathopt_ctx *ctx = pathopt_create(); // Graph, metrics and results
+
+  // "pathopt compile" writes a snapshot instead of optimizing
+  char *program = argv[0];
+  int compile = (argc > 1 && strcmp(argv[1], "compile") == 0);
+  if (compile) {
+    argc--;
+    argv++;
+  }
+
+  // Parse command line options
+  int option, threads = 1, stats = 0;
+  char *binary = NULL, *source = NULL, *destination = NULL;
+  struct option long_options[] = {{"stats", no_argument, NULL, 'S'}, {NULL, 0, NULL, 0}};
+  while ((option = getopt_long(argc, argv, "e:p:j:b:s:d:h", long_options, NULL)) != -1) {
+    if (option == 'e') {
+      if (strcmp(optarg, "rounds") == 0) ctx->optimize_engine = ENGINE_ROUNDS;
+      else if (strcmp(optarg, "label") == 0) ctx->optimize_engine = ENGINE_LABEL;
+      else usage(program);
+    } else if (option == 'p') {
+      if (strcmp(optarg, "mmap") == 0) ctx->parse_mode = PARSE_MMAP;
+      else if (strcmp(optarg, "stream") == 0) ctx->parse_mode = PARSE_STREAM;
+      else usage(program);
+    } else if (option == 'j') {
+      threads = atoi(optarg);
+      if (threads < 1) usage(program);
+    } else if (option == 'b' && !compile) {
+      binary = optarg;
+    } else if (option == 's' && !compile) {
+      source = optarg;
+    } else if (option == 'd' && !compile) {
+      destination = optarg;
+    } else if (option == 'S') {
+      stats = 1;
+    } else {
+      usage(program);
+    }
+  }
+  ctx->parse_threads = threads;
+  pathopt_stats_enable(ctx, stats);
+
+  // Parse the text file once and save the graph for later runs
+  if (compile) {
+    if (optind != argc - 2) usage(program);
+    printf("Compiling %s into %s\n", argv[optind], argv[optind + 1]);
+    int status = parse_file(ctx, argv[optind]);
+    if (status != ERROR) status = write_snapshot(ctx, argv[optind + 1]);
+    if (stats) display_stats(ctx, stderr);
+    pathopt_destroy(ctx);
+    return (status == ERROR) ? (1) : (0);
+  }
 
-  // We should have both input and output.
-  // We need a usage function as well to call if there is an issue with arguments
+  if (optind != argc - 1 || (destination != NULL && source == NULL) || (source != NULL && binary != NULL)) usage(program);
 
-  printf("File: %s\n", argv[1]);
+  printf("File: %s\n", argv[optind]);
   printf("\nParsing Input File\n");
-  parse_file(argv[1]);
+  if (parse_file(ctx, argv[optind]) == ERROR) {
+    pathopt_destroy(ctx);
+    return 1;
+  }
+
+  // Answer a single query without setting up the other sources
+  if (source != NULL) {
+    printf("\nQuerying %s%s%s\n", source, (destination != NULL) ? (" -> ") : (""), (destination != NULL) ? (destination) : (""));
+    int srcid = path_query(ctx, source, destination);
+    if (srcid == ERROR) {
+      pathopt_destroy(ctx);
+      return 1;
+    }
+    printf("\nGenerating Results File\n");
+    write_query_paths(ctx, stdout, srcid, (destination != NULL) ? (get_global_node_id(ctx, destination)) : (ERROR));
+    if (stats) display_stats(ctx, stderr);
+    pathopt_destroy(ctx);
+    return 0;
+  }
 
   // Initialize non-dominated path lists
   printf("\nInitializing Non-Dominated Path Lists\n");
-  init_global_path_table();
+  init_global_path_table(ctx);
   
-  // Optimize each pair one source at a time
+  // Optimize each pair, spreading the sources over the threads
   printf("\nCalculating Updated Non-Dominated Path Lists\n");
-  int nodecount = global_node_count();
-
-  // Process each source
-  for (int i=0; i<nodecount; i++) {
-    path_optimize_source_id(i);
-  }
+  path_optimize_all(ctx, threads);
 
   // Output the results
   printf("\nGenerating Results File\n");
-  write_optimized_paths(stdout);
+  int status = 0;
+  if (binary != NULL) status = write_optimized_paths_binary(ctx, binary);
+  else write_optimized_paths(ctx, stdout);
+  if (stats) display_stats(ctx, stderr);
+
+  // Release the graph and the paths
+  pathopt_destroy(ctx);
 
-  return 0;
+  return (status == ERROR) ? (1) : (0);
 }
@@ -5,6 +5,7 @@
 
 #include "global.h"
 #include "metrics.h"
+#include "graph.h"
 
 /****************************
  * Global Metrics Functions *
@@ -32,6 +33,9 @@ global_metric_struct *create_global_metrics_node(char *name, unsigned int opt, u
   new_global_metrics_node->opt = opt;
   new_global_metrics_node->combo = combo;
   new_global_metrics_node->arg = arg;
+  new_global_metrics_node->index = ERROR;
+  new_global_metrics_node->sign = (opt == OPT_MAX) ? (-1) : (1);
+  new_global_metrics_node->next = NULL;
   return new_global_metrics_node;
 }
 
@@ -45,20 +49,70 @@ global_metric_struct *create_global_metrics_node(char *name, unsigned int opt, u
  *   arg   - Optional argument (see combo)
  *
  * Creates a new global metric node and adds it to the global_metrics linked list.
+ * The metric is given the next ordinal, which is its position in every edge and
+ * path metric vector.  Metrics must be defined before any edges are added.
  */
-void add_global_metric(char *name, unsigned int opt, unsigned int combo, double arg) {
+void add_global_metric(pathopt_ctx *ctx, char *name, unsigned int opt, unsigned int combo, double arg) {
   if (DEBUG) printf("add_global_metric(%s, %d, %d, %f)\n", name, opt, combo, arg);
 
   // Verify it does not already exist
-  if (exists_global_metric(name)) {
+  if (exists_global_metric(ctx, name)) {
     printf("Global Metric \"%s\" already exists!\n", name);
     return;
   }
+  // Metric vectors already allocated cannot grow
+  if (global_edge_hash_count(ctx) > 0) {
+    printf("Error: Metric \"%s\" defined after edges were added\n", name);
+    exit(1);
+  }
   // Create new node
   global_metric_struct *new_node = create_global_metrics_node(name, opt, combo, arg);
   // Add new node to global metrics list
-  new_node->next = global_metrics;
-  global_metrics = new_node;
+  new_node->next = ctx->global_metrics;
+  ctx->global_metrics = new_node;
+
+  // Add new node to the ordinal table
+  global_metric_struct **new_table = realloc(ctx->global_metric_table, (ctx->global_metric_total + 1) * sizeof(global_metric_struct *));
+  if (new_table == NULL) {
+    printf("Memory Allocation failed: add_global_metric('%s')\n", name);
+    exit(1);
+  }
+  ctx->global_metric_table = new_table;
+  new_node->index = ctx->global_metric_total;
+  ctx->global_metric_table[ctx->global_metric_total++] = new_node;
+}
+
+/*
+ * get_global_metric_index - Lookup the ordinal of a metric based on its name
+ *
+ * Arguments:
+ *   name - Metric name
+ *
+ * Returns the ordinal of the metric, or ERROR if the name is not found.
+ */
+int get_global_metric_index(pathopt_ctx *ctx, char *name) {
+  for(int i=0; i < ctx->global_metric_total; i++) {
+    if (strncmp(ctx->global_metric_table[i]->name, name, NAME_MAX_LENGTH) == 0) return i;
+  }
+  return ERROR;
+}
+
+/*
+ * get_global_metric_index_span - Lookup the ordinal of a metric from a name that is not terminated
+ *
+ * Arguments:
+ *   name   - Start of the metric name
+ *   length - Number of characters in the name
+ *
+ * Same as get_global_metric_index, for a name inside a larger buffer.
+ */
+int get_global_metric_index_span(pathopt_ctx *ctx, const char *name, int length) {
+  if (length > NAME_MAX_LENGTH) length = NAME_MAX_LENGTH;
+  for(int i=0; i < ctx->global_metric_total; i++) {
+    char *other = ctx->global_metric_table[i]->name;
+    if (strncmp(other, name, length) == 0 && (length == NAME_MAX_LENGTH || other[length] == 0)) return i;
+  }
+  return ERROR;
 }
 
 /*
@@ -66,30 +120,67 @@ void add_global_metric(char *name, unsigned int opt, unsigned int combo, double
  *
  * Returns true if found, otherwise returns false.
  */
-int exists_global_metric(char *name) {
-  // External variables
-  extern global_metric_struct *global_metrics;
+int exists_global_metric(pathopt_ctx *ctx, char *name) {
   // Loop and look
-  for(global_metric_struct *current = global_metrics; current != NULL; current = current->next) {
+  for(global_metric_struct *current = ctx->global_metrics; current != NULL; current = current->next) {
     if (strncmp(current->name, name, NAME_MAX_LENGTH) == 0) return true;
   }
   return false;
 }
 
+/*
+ * free_global_metrics - Frees the metric schema
+ *
+ * Frees each metric in the global_metrics linked list and the ordinal
+ * table.  Every metric vector must be freed first.
+ */
+void free_global_metrics(pathopt_ctx *ctx) {
+  global_metric_struct *temp;
+  while (ctx->global_metrics != NULL) {
+    temp = ctx->global_metrics;
+    ctx->global_metrics = ctx->global_metrics->next;
+    free(temp);
+  }
+  free(ctx->global_metric_table);
+  ctx->global_metric_table = NULL;
+  ctx->global_metric_total = 0;
+}
+
 /*
  * global_metric_count - Counts the number of global metrics
  *
  * Returns the number of global metrics.
  */
-unsigned int global_metric_count() {
-  unsigned int total = 0;
-  global_metric_struct *current;
-  current = global_metrics;
-  while(current != NULL) {
-    total++;
-    current = current->next;
-  }
-  return total;
+unsigned int global_metric_count(pathopt_ctx *ctx) {
+  return ctx->global_metric_total;
+}
+
+/*
+ * get_global_metric_name - Lookup the name of a metric based on its ordinal
+ *
+ * Arguments:
+ *   index - Ordinal of the metric
+ *
+ * Returns a pointer to the name of the metric, or NULL if the ordinal is not found.
+ */
+char *get_global_metric_name(pathopt_ctx *ctx, int index) {
+  if (index < 0 || index >= ctx->global_metric_total) return NULL;
+  return ctx->global_metric_table[index]->name;
+}
+
+/*
+ * get_global_metric_sign - Lookup how a metric's values are normalized
+ *
+ * Arguments:
+ *   index - Ordinal of the metric
+ *
+ * Stored metric values are the real value times the sign (-1 for OPT_MAX,
+ * 1 otherwise), so multiplying a stored value by it gives the real value.
+ * Returns 0 if the ordinal is not found.
+ */
+double get_global_metric_sign(pathopt_ctx *ctx, int index) {
+  if (index < 0 || index >= ctx->global_metric_total) return 0;
+  return ctx->global_metric_table[index]->sign;
 }
 
 
@@ -99,41 +190,40 @@ unsigned int global_metric_count() {
  *********************/
 
 /*
- * create_metrics_node - Create a metrics node for the linked list
+ * create_metrics - Create a metric vector
  *
- * Arguments:
- *   name  - Metrics name string
- *   value - Metrics value string
+ * Allocates a vector with one value per global metric.  Every value starts
+ * as ERROR (-1), which is what a missing metric has always read as.
  *
- * Allocates the memory for the struct, assigns values and returns
- * the completed struct.
+ * Metric vectors are stored normalized so that smaller is always better:
+ * each value is multiplied by its metric's sign (-1 for OPT_MAX) when it is
+ * set, and multiplied back when it is read or displayed.
  */
-metric_struct *create_metrics_node(char *name, double value) {
-  metric_struct *new_metrics_node = malloc(sizeof(metric_struct));
-  if (new_metrics_node == NULL) {
-    printf("Memory Allocation failed: create_metric_node('%s', %f)\n", name, value);
+double *create_metrics(pathopt_ctx *ctx) {
+  double *new_metrics = malloc((ctx->global_metric_total > 0 ? ctx->global_metric_total : 1) * sizeof(double));
+  if (new_metrics == NULL) {
+    printf("Memory Allocation failed: create_metrics(%d)\n", ctx->global_metric_total);
     exit(1);
   }
-  strncpy(new_metrics_node->name, name, NAME_MAX_LENGTH);
-  new_metrics_node->value = value;
-  new_metrics_node->next = NULL;
-  return new_metrics_node;
+  for(int i=0; i < ctx->global_metric_total; i++) new_metrics[i] = ERROR * ctx->global_metric_table[i]->sign;
+  return new_metrics;
 }
 
 /*
- * add_metrics_node - Adds an additional metrics node
+ * set_metric_value - Sets a metric value by name
  *
  * Arguments:
- *   name  - Metrics name string
- *   value - Metrics value string
+ *   metrics - Metric vector
+ *   name    - String name of the metric
+ *   value   - New value
  *
- * Creates a new metric_struct and adds it to the existing linked list.
- * It then returns the new pointer to the linked list.
+ * Stores the value normalized.  Returns the ordinal that was set, or ERROR
+ * if the metric is not a global metric (the vector is left alone).
  */
-metric_struct *add_metrics_node(metric_struct *current, char *name, double value) {
-  metric_struct *new_node = create_metrics_node(name, value);
-  new_node->next = current;
-  return new_node;
+int set_metric_value(pathopt_ctx *ctx, double *metrics, char *name, double value) {
+  int index = get_global_metric_index(ctx, name);
+  if (index != ERROR) metrics[index] = value * ctx->global_metric_table[index]->sign;
+  return index;
 }
 
 /*
@@ -142,109 +232,73 @@ metric_struct *add_metrics_node(metric_struct *current, char *name, double value
  * Arguments:
  *   outfile - File pointer to print output to (includes stdout, stderr)
  *   prefix  - Text before the metrics
- *   metrics - The metrics linked list
+ *   metrics - The metric vector
  *   postfix - Text after the metrics
  *
  * Prints out the prefix, then the metrics, then the postfix.
  */
-void display_metrics(FILE *outfile, char *prefix, metric_struct *metrics, char *postfix) {
+void display_metrics(pathopt_ctx *ctx, FILE *outfile, char *prefix, double *metrics, char *postfix) {
+  if (outfile == NULL) outfile = stdout;
   // Prefix
-  if (outfile == NULL) printf("%s", prefix);
-  else fprintf(outfile, "%s", prefix);
+  fprintf(outfile, "%s", prefix);
   // Metrics
-  for (metric_struct *current = metrics; current != NULL; current = current->next) {
-    if (outfile == NULL) {
-      printf("%s=%0.2f", current->name, current->value);
-      if (current->next != NULL) printf(",");
-    } else {
-      fprintf(outfile, "%s=%0.2f", current->name, current->value);
-      if (current->next != NULL) fprintf(outfile, ",");
-    }
+  for (int i=0; i < ctx->global_metric_total; i++) {
+    fprintf(outfile, "%s=%0.2f", ctx->global_metric_table[i]->name, metrics[i] * ctx->global_metric_table[i]->sign);
+    if (i + 1 < ctx->global_metric_total) fprintf(outfile, ",");
   }
   // Postfix
-  if (outfile == NULL) printf("%s", postfix);
-  else fprintf(outfile, "%s", postfix);
+  fprintf(outfile, "%s", postfix);
 }
 
 /*
- * combine_metrics - Takes two metrics and returns a combined metric linked list
+ * combine_metrics - Combines two metric vectors
  *
  * Arguments:
- *   first  - The first metric linked list
- *   second - The second metric linked list
+ *   result - Vector to store the combined metrics in
+ *   first  - The first metric vector
+ *   second - The second metric vector
  *
- * Walks through the global list of metrics and conbines each metric.  Returns a
- * new linked list with the combined metrics and leaves the original metrics
- * linked lists alone.  Returns NULL if any of the linked lists contain value
- * errors.
+ * Walks through the global metrics by ordinal and combines each metric
+ * into result.  The original vectors are left alone (result may be one
+ * of them).  The vectors are normalized, so for OPT_MAX metrics (sign -1)
+ * the minimum of the real values is the maximum of the stored ones and
+ * the optional argument is added negated.
  */
-metric_struct *combine_metrics(metric_struct *first, metric_struct *second) {
-  metric_struct *new_metrics = NULL;
-  // for loop through global metrics list
-  for (global_metric_struct *gms = global_metrics; gms != NULL; gms = gms->next) {
-    double value1, value2, new_value;
-    value1 = get_metric_value(first, gms->name);
-    value2 = get_metric_value(second, gms->name);
+void combine_metrics(pathopt_ctx *ctx, double *result, const double *first, const double *second) {
+  for (int i=0; i < ctx->global_metric_total; i++) {
+    global_metric_struct *gms = ctx->global_metric_table[i];
+    double value1 = first[i], value2 = second[i];
 
     // Combine the values
     if (gms->combo == COMBO_ADD) {
-      new_value = value1 + value2;
-      if (gms->arg) new_value += gms->arg; // Optional additional value
-    }
-    if (gms->combo == COMBO_MIN) {
-      new_value = (value1 < value2) ? (value1) : (value2); // Set to the minimum of the values
-    }
-    if (gms->combo == COMBO_MAX) {
-      new_value = (value1 > value2) ? (value1) : (value2); // Set to the maximum of the values
-    }
-
-    metric_struct *temp = create_metrics_node(gms->name, new_value);
-    if (new_metrics == NULL) {
-      new_metrics = temp;
+      result[i] = value1 + value2 + gms->arg * gms->sign; // Optional additional value
+    } else if ((gms->combo == COMBO_MIN) == (gms->sign > 0)) {
+      result[i] = (value1 < value2) ? (value1) : (value2); // Set to the minimum of the values
     } else {
-      temp->next = new_metrics;
-      new_metrics = temp;
+      result[i] = (value1 > value2) ? (value1) : (value2); // Set to the maximum of the values
     }
   }
-
-  return new_metrics;
 }
 
 /*
- * copy_metrics - Make a copy of a metrics linked list
+ * copy_metrics - Copy a metric vector
  *
  * Arguments:
- *   metrics - Metrics linked list to copy
- *
- * Copys the linked list and returns the new copy of the list.
+ *   dest    - Vector to copy into
+ *   metrics - Vector to copy
  */
-metric_struct *copy_metrics(metric_struct *metrics) {
-  // Create a new metrics pointer
-  metric_struct *new_metrics = NULL;
-  // Iterate through the metrics linked list and copy each node
-  for (metric_struct *current = metrics; current != NULL; current = current->next) {
-    if (new_metrics == NULL) new_metrics = create_metrics_node(current->name, current->value);
-    else new_metrics = add_metrics_node(new_metrics, current->name, current->value);
-  }
-  // Return the metrics copy
-  return new_metrics;
+void copy_metrics(pathopt_ctx *ctx, double *dest, const double *metrics) {
+  memcpy(dest, metrics, ctx->global_metric_total * sizeof(double));
 }
 
 /*
- * delete_metrics - Delete a metrics linked list
+ * delete_metrics - Delete a metric vector
  *
  * Arguments:
- *   metrics - Metrics linked list
- *
- * Deletes metrics nodes in a metrics linked list
+ *   metrics - Metric vector from create_metrics
  */
-void delete_metrics(metric_struct *metrics) {
-  metric_struct *temp;
-  while(metrics != NULL) {
-    temp = metrics;
-    metrics = metrics->next;
-    free(temp);
-  }
+void delete_metrics(double *metrics) {
+  free(metrics);
 }
 
 
@@ -252,19 +306,14 @@ void delete_metrics(metric_struct *metrics) {
  * get_metric_value - Returns a requested metric value
  *
  * Arguments:
- *   metric - Linked list to the metrics
- *   name   - String name of the metric requested
+ *   metrics - Metric vector
+ *   name    - String name of the metric requested
  *
- * Walks through the list of metrics and returns the metric value for the
- * metric with the matching name.  If the metric is not found, it returns
- * the value ERROR (-1).
+ * Looks up the ordinal of the metric and returns its (denormalized) value.
+ * If the metric is not found, it returns the value ERROR (-1).
  */
-double get_metric_value(metric_struct *metric, char *name) {
-  for(metric_struct *current = metric; current != NULL; current = current->next) {
-    if (strncmp(current->name, name, NAME_MAX_LENGTH) == 0) {
-      return current->value;
-    }
-  }
-  return ERROR;
+double get_metric_value(pathopt_ctx *ctx, double *metrics, char *name) {
+  int index = get_global_metric_index(ctx, name);
+  if (index == ERROR) return ERROR;
+  return metrics[index] * ctx->global_metric_table[index]->sign;
 }
-
@@ -5,19 +5,24 @@
  * Global Metrics Functions *
  ****************************/
 global_metric_struct *create_global_metrics_node(char *name, unsigned int opt, unsigned int combo, double arg);
-void add_global_metric(char *name, unsigned int opt, unsigned int combo, double arg);
-int exists_global_metric(char *name);
-unsigned int global_metric_count();
+void add_global_metric(pathopt_ctx *ctx, char *name, unsigned int opt, unsigned int combo, double arg);
+int exists_global_metric(pathopt_ctx *ctx, char *name);
+int get_global_metric_index(pathopt_ctx *ctx, char *name);
+int get_global_metric_index_span(pathopt_ctx *ctx, const char *name, int length);
+void free_global_metrics(pathopt_ctx *ctx);
+unsigned int global_metric_count(pathopt_ctx *ctx);
+char *get_global_metric_name(pathopt_ctx *ctx, int index);
+double get_global_metric_sign(pathopt_ctx *ctx, int index);
 
 /*********************
  * Metrics Functions *
  *********************/
-metric_struct *create_metrics_node(char *name, double value);
-metric_struct *add_metrics_node(metric_struct *current, char *name, double value);
-void display_metrics(FILE *outfile, char *prefix, metric_struct *metrics, char *postfix);
-metric_struct *combine_metrics(metric_struct *first, metric_struct *second);
-metric_struct *copy_metrics(metric_struct *metrics);
-double get_metric_value(metric_struct *metric, char *name);
-void delete_metrics(metric_struct *metrics);
+double *create_metrics(pathopt_ctx *ctx);
+int set_metric_value(pathopt_ctx *ctx, double *metrics, char *name, double value);
+void display_metrics(pathopt_ctx *ctx, FILE *outfile, char *prefix, double *metrics, char *postfix);
+void combine_metrics(pathopt_ctx *ctx, double *result, const double *first, const double *second);
+void copy_metrics(pathopt_ctx *ctx, double *dest, const double *metrics);
+double get_metric_value(pathopt_ctx *ctx, double *metrics, char *name);
+void delete_metrics(double *metrics);
 
 #endif
@@ -1,11 +1,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>  // true, false
+#include <fcntl.h>    // open
+#include <unistd.h>   // close
+#include <sys/mman.h> // mmap, munmap, madvise
+#include <sys/stat.h> // fstat
+#include <pthread.h>  // pthread_create, pthread_join
 
 #include "global.h"
 #include "metrics.h"
 #include "graph.h"
+#include "snapshot.h"
 #include "parser.h"
+#include "stats.h"
 
 /********************
  * Parser Functions *
@@ -16,25 +24,63 @@
  *
  * Parses a file in the format of the files in the "examples" subfolder, with an [edges], [nodes], and
  * [metrics] section, into the global data structures specified in metrics.h.
- * It then calls each of the individual line processing functions to parse the lines in each of their
- * respective sections.
+ * A snapshot written by write_snapshot is loaded with load_snapshot instead.
+ * Otherwise the file is read with parse_file_mmap or parse_file_stream depending on
+ * parse_mode, which call the individual line processing functions for the lines in each of their
+ * respective sections.  Returns ERROR if the file could not be read.
  */
-void parse_file(char* filename) {
+int parse_file(pathopt_ctx *ctx, char* filename) {
   if (DEBUG) printf("parse_file(\"%s\")\n", filename);
 
-  FILE* file = fopen(filename, "r");
+  double started = stats_clock();
+
+  // Compiled snapshots are loaded as they are
+  if (is_snapshot(filename)) {
+    int status = load_snapshot(ctx, filename);
+    ctx->phase_seconds[PHASE_PARSE] += stats_clock() - started;
+    return status;
+  }
+
+  int status = (ctx->parse_mode == PARSE_MMAP) ? (parse_file_mmap(ctx, filename)) : (parse_file_stream(ctx, filename));
+  if (status == ERROR) {
+    printf("Error opening file!\n");
+    return ERROR;
+  }
+
+  // Build the out-neighbor index used by the optimizer
+  build_global_adjacency(ctx);
+  ctx->phase_seconds[PHASE_PARSE] += stats_clock() - started;
 
-  if (file == NULL) {
-    printf("Error opening file!");
-    return;
+  // Display loaded statistics
+  if (DEBUG) {
+    printf("\nParsed Statistics:\n");
+    printf("Total Metrics: %d\n", global_metric_count(ctx));
+    printf("Total Nodes: %d\n", global_node_count(ctx));
+    printf("Total Edges: %d\n", global_edge_hash_count(ctx));
   }
+  return 0;
+} // End of parse_file
+
+/*
+ * parse_file_stream - Reads the input file line by line
+ *
+ * Arguments:
+ *   filename - Input file name
+ *
+ * Reads lines of up to BUFFER_LEN characters with fgets and hands them to
+ * the line parsers.  Returns ERROR if the file cannot be opened.
+ */
+int parse_file_stream(pathopt_ctx *ctx, char *filename) {
+  FILE* file = fopen(filename, "r");
+
+  if (file == NULL) return ERROR;
 
   char line[BUFFER_LEN]; // defined in global.h
   int section = ERROR;   // defined in global.h
 
   while (fgets(line, BUFFER_LEN, file)) {
-    // Remove newline character if present.
-    line[strcspn(line, "\n")] = 0;
+    // Remove newline characters (including a DOS carriage return) if present.
+    line[strcspn(line, "\r\n")] = 0;
     
     // Ignore blank lines and comments
     if (strlen(line) == 0) continue;
@@ -42,15 +88,7 @@ void parse_file(char* filename) {
     
     // Detect section headings
     if (line[0] == '[') {
-      // Determine the section
-      if (strncmp(line, "[metrics]", 9) == 0) section = SECTION_METRICS;
-      else if (strncmp(line, "[nodes]", 7) == 0) section = SECTION_NODES;
-      else if (strncmp(line, "[edges]", 7) == 0) section = SECTION_EDGES;
-      else {
-	printf("Error: Invalid section \"%s\"\n", line);
-	exit(1);
-      }
-      
+      section = parse_section(line, strlen(line));
     } else {
       if (section == ERROR) {
 	printf("Error: Not in a section \"%s\"", line);
@@ -58,25 +96,110 @@ void parse_file(char* filename) {
       }
       
       // Parse section lines
-      if (section == SECTION_METRICS) parse_metric(line);
-      else if (section == SECTION_NODES) parse_node(line);
-      else if (section == SECTION_EDGES) parse_edge(line);
-      else {
-	printf("Error: Invalid Section ID %d\n", section);
-	exit(1);
-      }
+      if (section == SECTION_METRICS) parse_metric(ctx, line);
+      else if (section == SECTION_NODES) parse_node(ctx, line);
+      else parse_edge(ctx, line);
     } // End of section lines
   } // End of input
+  fclose(file);
+  return 0;
+}
 
-  // Display loaded statistics
-  if (DEBUG) {
-    printf("\nParsed Statistics:\n");
-    printf("Total Metrics: %d\n", global_metric_count());
-    printf("Total Nodes: %d\n", global_node_count());
-    printf("Total Edges: %d\n", global_edge_hash_count());
+/*
+ * parse_file_mmap - Reads the input file through a memory map
+ *
+ * Arguments:
+ *   filename - Input file name
+ *
+ * Maps the whole file and scans it in place, so lines can be any length.
+ * Edge lines, which are nearly all of a large file, are handed to
+ * parse_edges_section and tokenized in the mapping without copying: node
+ * and metric names are
+ * looked up straight from the mapped bytes (the node table is the only
+ * copy of a name) and values are read with parse_number.  The few metric
+ * and node lines are copied out and passed to parse_metric and parse_node.
+ * Returns ERROR if the file cannot be opened or mapped.
+ */
+int parse_file_mmap(pathopt_ctx *ctx, char *filename) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) return ERROR;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return ERROR;
   }
-  
-} // End of parse_file
+  size_t size = info.st_size;
+  char *data = NULL;
+  if (size > 0) {
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      return ERROR;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  int section = ERROR;
+  const char *end = data + size;
+  for(const char *line = data; line < end; ) {
+    const char *eol = memchr(line, '\n', end - line);
+    if (eol == NULL) eol = end;
+    const char *next = (eol < end) ? (eol + 1) : (end);
+    if (eol > line && eol[-1] == '\r') eol--;
+    int length = eol - line;
+
+    // Ignore blank lines and comments
+    if (length == 0 || line[0] == '#') {
+      line = next;
+      continue;
+    }
+
+    if (line[0] == '[') {
+      section = parse_section(line, length);
+      // The edges section runs to the next heading
+      if (section == SECTION_EDGES) next = parse_edges_section(ctx, next, end);
+    } else {
+      // Metric and node lines are few, so reuse the string parsers
+      char *copy = malloc(length + 1);
+      if (copy == NULL) {
+	printf("Memory Allocation failed: parse_file_mmap(%d)\n", length);
+	exit(1);
+      }
+      memcpy(copy, line, length);
+      copy[length] = 0;
+      if (section == ERROR) {
+	printf("Error: Not in a section \"%s\"", copy);
+	exit(1);
+      }
+      if (section == SECTION_METRICS) parse_metric(ctx, copy);
+      else parse_node(ctx, copy);
+      free(copy);
+    }
+    line = next;
+  }
+
+  if (data != NULL) munmap(data, size);
+  return 0;
+}
+
+/*
+ * parse_section - Parses a section heading
+ *
+ * Arguments:
+ *   line   - The heading line, starting with '['
+ *   length - Number of characters in the line
+ *
+ * Returns the SECTION_* value for the heading.  Unknown headings are fatal.
+ */
+int parse_section(const char *line, int length) {
+  if (length >= 9 && strncmp(line, "[metrics]", 9) == 0) return SECTION_METRICS;
+  if (length >= 7 && strncmp(line, "[nodes]", 7) == 0) return SECTION_NODES;
+  if (length >= 7 && strncmp(line, "[edges]", 7) == 0) return SECTION_EDGES;
+  printf("Error: Invalid section \"%.*s\"\n", length, line);
+  exit(1);
+}
 
 /*
  * parse_metric - Parses a single metric line
@@ -87,7 +210,7 @@ void parse_file(char* filename) {
  * Parses a line from the metrics file into the parts required by 
  * add_global_metric, then passes the parts to that function.
  */
-void parse_metric(char *line) {
+void parse_metric(pathopt_ctx *ctx, char *line) {
   char *token;
   char metric[NAME_MAX_LENGTH];
   int optimization = ERROR, combination = ERROR;
@@ -123,7 +246,7 @@ void parse_metric(char *line) {
   }
 
   // Add metric information to global list
-  add_global_metric(metric, optimization, combination, arg);
+  add_global_metric(ctx, metric, optimization, combination, arg);
 }
 
 /*
@@ -135,7 +258,7 @@ void parse_metric(char *line) {
  * Parses a line from the nodes section into the parts required by 
  * add_global_node, then passes the parts to that function.
  */
-void parse_node(char *line) {
+void parse_node(pathopt_ctx *ctx, char *line) {
   char *token;
   char name[NAME_MAX_LENGTH];
   char descr[NAME_MAX_LENGTH];
@@ -151,7 +274,7 @@ void parse_node(char *line) {
   strncpy(descr, token, NAME_MAX_LENGTH);
 
   // Add node to global list
-  add_global_node(name, descr);
+  add_global_node(ctx, name, descr);
 }
 
 /*
@@ -163,14 +286,14 @@ void parse_node(char *line) {
  * Parses a line from the edges section into the parts required by 
  * add_global_edge, then passes the parts to that function.
  */
-void parse_edge(char *line) {
+void parse_edge(pathopt_ctx *ctx, char *line) {
   char *token;
   char *metric_token;
   char metric_name[NAME_MAX_LENGTH];
   double metric_value;
   char srcnode[NAME_MAX_LENGTH];
   char dstnode[NAME_MAX_LENGTH];
-  metric_struct *metrics = NULL;
+  double *metrics = create_metrics(ctx);
   int i;
   
   if (DEBUG) printf("parse_edge(\"%s\")\n", line);
@@ -193,11 +316,9 @@ void parse_edge(char *line) {
       if (metric_name[i] == '=') {
 	metric_name[i] = 0; // Metric Name
 	metric_value = atof(metric_name + i + 1); // Metric value
-	// Create or add to metrics list
-	if (metrics == NULL) {
-	  metrics = create_metrics_node(metric_name, metric_value);
-	} else {
-	  metrics = add_metrics_node(metrics, metric_name, metric_value);
+	// Store in the metric vector
+	if (set_metric_value(ctx, metrics, metric_name, metric_value) == ERROR) {
+	  printf("Error: Unknown metric \"%s\" on edge %s|%s\n", metric_name, srcnode, dstnode);
 	}
 	break;
       }
@@ -205,5 +326,251 @@ void parse_edge(char *line) {
     metric_token = strtok(NULL, ",");
   }
 
-  add_global_edge(srcnode, dstnode, metrics);
+  add_global_edge(ctx, srcnode, dstnode, metrics);
+}
+
+/*
+ * parse_edges_section - Parses the lines of an [edges] section in a mapped file
+ *
+ * Arguments:
+ *   start - First line after the [edges] heading
+ *   end   - End of the file
+ *
+ * Finds where the section ends (the next line starting with '['), splits it
+ * into parse_threads chunks on line boundaries and parses each chunk on its
+ * own thread into a local buffer with parse_edges_worker.  The node and
+ * metric tables are only read while the threads run.  The buffers are then
+ * merged into the edge hash table in chunk order, so the result (including
+ * which copy of a repeated edge wins, and the order of error messages) is
+ * the same as parsing the lines one by one.  Sections smaller than
+ * PARSE_CHUNK_BYTES per thread use fewer threads.  Returns the end of the
+ * section.
+ */
+const char *parse_edges_section(pathopt_ctx *ctx, const char *start, const char *end) {
+  // The section ends at the first heading
+  const char *stop = start;
+  while (stop < end && *stop != '[') {
+    const char *eol = memchr(stop, '\n', end - stop);
+    stop = (eol != NULL) ? (eol + 1) : (end);
+  }
+
+  int threads = ctx->parse_threads;
+  if (threads > (stop - start) / PARSE_CHUNK_BYTES + 1) threads = (stop - start) / PARSE_CHUNK_BYTES + 1;
+  if (threads < 1) threads = 1;
+
+  // Split the section on line boundaries
+  parse_chunk_struct chunks[threads];
+  const char *chunk_start = start;
+  for(int i=0; i < threads; i++) {
+    const char *chunk_end = (i == threads - 1) ? (stop) : (start + (stop - start) * (i + 1) / threads);
+    if (chunk_end < chunk_start) chunk_end = chunk_start;
+    if (chunk_end < stop && chunk_end > start && chunk_end[-1] != '\n') {
+      const char *eol = memchr(chunk_end, '\n', stop - chunk_end);
+      chunk_end = (eol != NULL) ? (eol + 1) : (stop);
+    }
+    memset(&chunks[i], 0, sizeof(parse_chunk_struct));
+    chunks[i].ctx = ctx;
+    chunks[i].start = chunk_start;
+    chunks[i].end = chunk_end;
+    chunk_start = chunk_end;
+  }
+
+  // Parse the chunks (the first one on this thread)
+  pthread_t workers[threads];
+  for(int i=1; i < threads; i++) {
+    if (pthread_create(&workers[i], NULL, parse_edges_worker, &chunks[i]) != 0) {
+      fprintf(stderr, "Error: Could not create parser thread %d\n", i);
+      exit(1);
+    }
+  }
+  parse_edges_worker(&chunks[0]);
+  for(int i=1; i < threads; i++) pthread_join(workers[i], NULL);
+
+  // Merge in chunk order
+  unsigned int total = ctx->edge_hash_used;
+  for(int i=0; i < threads; i++) total += chunks[i].count;
+  reserve_global_edge_table(ctx, total);
+  for(int i=0; i < threads; i++) {
+    if (chunks[i].message_length > 0) fwrite(chunks[i].messages, 1, chunks[i].message_length, stdout);
+    for(int j=0; j < chunks[i].count; j++) {
+      add_global_edge_ids(ctx, chunks[i].ids[2 * j], chunks[i].ids[2 * j + 1], chunks[i].metrics[j]);
+    }
+    free(chunks[i].messages);
+    free(chunks[i].ids);
+    free(chunks[i].metrics);
+  }
+
+  if (DEBUG) printf("parse_edges_section: %d edges on %d threads\n", total, threads);
+  return stop;
+}
+
+/*
+ * parse_edges_worker - Thread body for parse_edges_section
+ *
+ * Arguments:
+ *   arg - The parse_chunk_struct to parse
+ *
+ * Tokenizes every edge line of the chunk with scan_edge_line and keeps the
+ * results in the chunk.  Error messages are written to a memory stream
+ * that is printed when the chunk is merged.
+ */
+void *parse_edges_worker(void *arg) {
+  parse_chunk_struct *chunk = arg;
+  pathopt_ctx *ctx = chunk->ctx;
+  FILE *messages = open_memstream(&chunk->messages, &chunk->message_length);
+  if (messages == NULL) {
+    printf("Memory Allocation failed: parse_edges_worker\n");
+    exit(1);
+  }
+
+  for(const char *line = chunk->start; line < chunk->end; ) {
+    const char *eol = memchr(line, '\n', chunk->end - line);
+    if (eol == NULL) eol = chunk->end;
+    const char *next = (eol < chunk->end) ? (eol + 1) : (chunk->end);
+    if (eol > line && eol[-1] == '\r') eol--;
+
+    // Ignore blank lines and comments
+    if (eol > line && line[0] != '#') {
+      int srcid, dstid;
+      double *metrics = scan_edge_line(ctx, line, eol, messages, &srcid, &dstid);
+      if (metrics != NULL) {
+	if (chunk->count == chunk->capacity) {
+	  int capacity = (chunk->capacity == 0) ? (1024) : (chunk->capacity * 2);
+	  int *ids = realloc(chunk->ids, 2 * capacity * sizeof(int));
+	  if (ids != NULL) chunk->ids = ids;
+	  double **vectors = realloc(chunk->metrics, capacity * sizeof(double *));
+	  if (vectors != NULL) chunk->metrics = vectors;
+	  if (ids == NULL || vectors == NULL) {
+	    printf("Memory Allocation failed: parse_edges_worker(%d)\n", capacity);
+	    exit(1);
+	  }
+	  chunk->capacity = capacity;
+	}
+	chunk->ids[2 * chunk->count] = srcid;
+	chunk->ids[2 * chunk->count + 1] = dstid;
+	chunk->metrics[chunk->count++] = metrics;
+      }
+    }
+    line = next;
+  }
+
+  fclose(messages);
+  return NULL;
+}
+
+/*
+ * scan_edge_line - Tokenizes a single edge line in place
+ *
+ * Arguments:
+ *   line     - Start of a line from the edges section
+ *   end      - End of the line (without the newline)
+ *   messages - Where to write error messages
+ *   srcid    - Set to the source node id
+ *   dstid    - Set to the destination node id
+ *
+ * Does the same as parse_edge without changing or copying the line: the
+ * fields are found with memchr, the node names are resolved to ids and the
+ * metric names to ordinals straight from the line, and the values are read
+ * with parse_number.  Only reads the context's tables, so it can run on
+ * several threads.  Returns the edge's new metric vector, or NULL if the
+ * line is not a valid edge.
+ */
+double *scan_edge_line(pathopt_ctx *ctx, const char *line, const char *end, FILE *messages, int *srcid, int *dstid) {
+  if (DEBUG) printf("scan_edge_line(\"%.*s\")\n", (int)(end - line), line);
+
+  // Source and destination node names
+  const char *src = line;
+  const char *src_end = memchr(src, '|', end - src);
+  const char *dst = (src_end != NULL) ? (src_end + 1) : (end);
+  const char *dst_end = memchr(dst, '|', end - dst);
+  if (src_end == NULL || dst_end == NULL) {
+    fprintf(messages, "Error: Invalid edge \"%.*s\"\n", (int)(end - line), line);
+    return NULL;
+  }
+  int srclen = src_end - src, dstlen = dst_end - dst;
+
+  // The metrics are name=value pairs up to the end of the line (or another field)
+  double *metrics = create_metrics(ctx);
+  const char *fields_end = memchr(dst_end + 1, '|', end - (dst_end + 1));
+  if (fields_end == NULL) fields_end = end;
+  for(const char *field = dst_end + 1; field < fields_end; ) {
+    const char *field_end = memchr(field, ',', fields_end - field);
+    if (field_end == NULL) field_end = fields_end;
+    const char *equals = memchr(field, '=', field_end - field);
+    if (equals != NULL) {
+      int index = get_global_metric_index_span(ctx, field, equals - field);
+      if (index == ERROR) {
+	fprintf(messages, "Error: Unknown metric \"%.*s\" on edge %.*s|%.*s\n", (int)(equals - field), field, srclen, src, dstlen, dst);
+      } else {
+	metrics[index] = parse_number(equals + 1, field_end) * ctx->global_metric_table[index]->sign;
+      }
+    }
+    field = field_end + 1;
+  }
+
+  *srcid = get_global_node_id_span(ctx, src, srclen);
+  *dstid = get_global_node_id_span(ctx, dst, dstlen);
+  if (*srcid == ERROR || *dstid == ERROR) {
+    fprintf(messages, "Error: Edge \"%.*s\" -> \"%.*s\" references an unknown node\n", srclen, src, dstlen, dst);
+    delete_metrics(metrics);
+    return NULL;
+  }
+  return metrics;
+}
+
+/*
+ * parse_number - Reads a decimal number that is not terminated
+ *
+ * Arguments:
+ *   text - Start of the number
+ *   end  - End of the buffer (the number may stop earlier)
+ *
+ * Handles plain decimals, the common case in edge dumps, with one multiply
+ * or divide: the digits are gathered into an integer and scaled by an exact
+ * power of ten, which rounds correctly while the digits fit in 53 bits and
+ * the power is at most 10^22.  Anything else (more digits, large exponents,
+ * inf, hex) is copied out and passed to strtod, so the result always
+ * matches atof.  Like atof, leading blanks are skipped and the number ends
+ * at the first character that does not belong to it.
+ */
+double parse_number(const char *text, const char *end) {
+  static const double powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const char *start = text;
+  unsigned long long mantissa = 0;
+  int digits = 0, scale = 0, negative = false;
+
+  while (text < end && (*text == ' ' || *text == '\t')) text++;
+  if (text < end && (*text == '-' || *text == '+')) negative = (*text++ == '-');
+  for(; text < end && *text >= '0' && *text <= '9'; text++, digits++) mantissa = mantissa * 10 + (*text - '0');
+  if (text < end && *text == '.') {
+    for(text++; text < end && *text >= '0' && *text <= '9'; text++, digits++, scale--) mantissa = mantissa * 10 + (*text - '0');
+  }
+  if (text < end && (*text == 'e' || *text == 'E')) {
+    const char *exponent = text + 1;
+    int exp_negative = false, exp_value = 0, exp_digits = 0;
+    if (exponent < end && (*exponent == '-' || *exponent == '+')) exp_negative = (*exponent++ == '-');
+    for(; exponent < end && *exponent >= '0' && *exponent <= '9' && exp_value < 10000; exponent++, exp_digits++) {
+      exp_value = exp_value * 10 + (*exponent - '0');
+    }
+    if (exp_digits > 0) scale += (exp_negative) ? (-exp_value) : (exp_value);
+  }
+
+  // Fast path: exact mantissa and power of ten (not the 0 of a hex number)
+  int hex = (text < end && (*text == 'x' || *text == 'X'));
+  if (digits > 0 && digits <= 15 && scale >= -22 && scale <= 22 && !hex) {
+    double value = (double)mantissa;
+    value = (scale < 0) ? (value / powers[-scale]) : (value * powers[scale]);
+    return (negative) ? (-value) : (value);
+  }
+
+  // Slow path through strtod
+  char buffer[BUFFER_LEN];
+  int length = end - start;
+  if (length >= BUFFER_LEN) length = BUFFER_LEN - 1;
+  memcpy(buffer, start, length);
+  buffer[length] = 0;
+  return strtod(buffer, NULL);
 }
@@ -5,9 +5,16 @@
  * Parser Functions *
  ********************/
 
-void parse_file(char* filename);
-void parse_metric(char *line);
-void parse_node(char *line);
-void parse_edge(char *line);
+int parse_file(pathopt_ctx *ctx, char* filename);
+int parse_file_stream(pathopt_ctx *ctx, char *filename);
+int parse_file_mmap(pathopt_ctx *ctx, char *filename);
+int parse_section(const char *line, int length);
+void parse_metric(pathopt_ctx *ctx, char *line);
+void parse_node(pathopt_ctx *ctx, char *line);
+void parse_edge(pathopt_ctx *ctx, char *line);
+const char *parse_edges_section(pathopt_ctx *ctx, const char *start, const char *end);
+void *parse_edges_worker(void *arg);
+double *scan_edge_line(pathopt_ctx *ctx, const char *line, const char *end, FILE *messages, int *srcid, int *dstid);
+double parse_number(const char *text, const char *end);
 
 #endif
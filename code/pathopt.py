@@ -1,32 +1,375 @@
 #!/usr/bin/python3
 
+import asyncio
 import ctypes
+import math
+import mmap
+import struct
 import sys
 
+# NumPy is optional: fronts are NumPy arrays when it is there, memoryviews otherwise
+try:
+    import numpy
+except ImportError:
+    numpy = None
+
+# Optimization engines and parser modes (see global.h)
+ENGINES = {"rounds": 0, "label": 1}
+PARSERS = {"stream": 0, "mmap": 1}
+
+# Binary result file header (see results_header_struct in global.h)
+RESULTS_MAGIC = b"PATHOPTR"
+RESULTS_VERSION = 1
+RESULTS_HEADER = struct.Struct("=8sIIII9Q")
+
+# One pair's front as flat arrays (see path_front_struct in global.h)
+class PathFront(ctypes.Structure):
+    _fields_ = [("count", ctypes.c_int),
+                ("metric_count", ctypes.c_int),
+                ("values", ctypes.POINTER(ctypes.c_double)),
+                ("offsets", ctypes.POINTER(ctypes.c_int)),
+                ("nodes", ctypes.POINTER(ctypes.c_int))]
+
+# Progress of an optimization run (see optimize_progress_struct in global.h)
+class OptimizeProgress(ctypes.Structure):
+    _fields_ = [("sources_done", ctypes.c_int),
+                ("source_total", ctypes.c_int),
+                ("paths", ctypes.c_ulong),
+                ("running", ctypes.c_int),
+                ("cancelled", ctypes.c_int)]
+
+# Counters and phase timers (see pathopt_stats_struct in global.h)
+class PathStats(ctypes.Structure):
+    _fields_ = [("extends", ctypes.c_ulong),
+                ("dominance_checks", ctypes.c_ulong),
+                ("accepts", ctypes.c_ulong),
+                ("rejects", ctypes.c_ulong),
+                ("evictions", ctypes.c_ulong),
+                ("rounds", ctypes.c_ulong),
+                ("max_rounds", ctypes.c_ulong),
+                ("labels", ctypes.c_ulong),
+                ("peak_front", ctypes.c_int),
+                ("peak_srcid", ctypes.c_int),
+                ("peak_dstid", ctypes.c_int),
+                ("allocations", ctypes.c_ulong),
+                ("peak_bytes", ctypes.c_size_t),
+                ("parse_seconds", ctypes.c_double),
+                ("init_seconds", ctypes.c_double),
+                ("optimize_seconds", ctypes.c_double),
+                ("write_seconds", ctypes.c_double)]
+
+def flat_view(pointer, ctype, shape):
+    # Wraps library memory as an array of the given shape without copying
+    size = math.prod(shape)
+    if size == 0:
+        # memoryview cannot take a shape with zeros, so empty views are flat
+        view = memoryview(b"").cast(ctype._type_)
+        return numpy.asarray(view).reshape(shape) if numpy is not None else view
+    array = ctypes.cast(pointer, ctypes.POINTER(ctype * size)).contents
+    view = memoryview(array).cast("B").cast(ctype._type_, shape)
+    return numpy.asarray(view) if numpy is not None else view
+
 class PathOpt:
-    def __init__(self, filename):
+    def __init__(self, filename, engine="label", threads=1, parser="mmap", optimize=True, stats=False):
         self.pathopt = ctypes.CDLL("./pathopt.so")
 
-        # Initialize pathopt library
-        self.pathopt.global_initialize()
+        # Each PathOpt has its own context (graph, metrics and results)
+        self.pathopt.pathopt_create.restype = ctypes.c_void_p
+        self.pathopt.pathopt_configure.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int]
+        self.pathopt.pathopt_destroy.argtypes = [ctypes.c_void_p]
+        self.pathopt.global_metric_count.argtypes = [ctypes.c_void_p]
+        self.ctx = self.pathopt.pathopt_create()
+        self.pathopt.pathopt_configure(self.ctx, ENGINES[engine], PARSERS[parser], threads)
+
+        # With stats=True the hot path counters are kept (see stats())
+        self.pathopt.pathopt_stats_enable.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        self.pathopt.pathopt_stats_enable(self.ctx, stats)
 
         # Read in file
-        self.pathopt.parse_file.argtypes = [ctypes.c_char_p]
+        self.pathopt.parse_file.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
         self.filename = ctypes.c_char_p(filename.encode('utf-8'))
-        self.pathopt.parse_file(self.filename)
+        if self.pathopt.parse_file(self.ctx, self.filename) < 0:
+            self.close()
+            raise IOError("Could not read %s" % filename)
+
+        # Metric names and how their values are normalized, by ordinal
+        self.pathopt.get_global_metric_name.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        self.pathopt.get_global_metric_name.restype = ctypes.c_char_p
+        self.pathopt.get_global_metric_sign.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        self.pathopt.get_global_metric_sign.restype = ctypes.c_double
+        metric_total = self.pathopt.global_metric_count(self.ctx)
+        self.metrics = [self.pathopt.get_global_metric_name(self.ctx, i).decode('utf-8') for i in range(metric_total)]
+        self.signs = [self.pathopt.get_global_metric_sign(self.ctx, i) for i in range(metric_total)]
+
+        # With optimize=False nothing is optimized until query(), front(), start()
+        # or optimize_async() asks for it
+        self.threads = threads
+        self.optimized = optimize
+        if not optimize:
+            self.pathopt.init_path_table.argtypes = [ctypes.c_void_p]
+            self.pathopt.init_path_table(self.ctx)
+            return
 
         # Initialize non-dominated path lists
-        self.pathopt.init_global_path_table();
+        self.pathopt.init_global_path_table.argtypes = [ctypes.c_void_p]
+        self.pathopt.init_global_path_table(self.ctx);
+
+        # Optimize each pair, spreading the sources over the threads
+        self.pathopt.path_optimize_all.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        self.pathopt.path_optimize_all(self.ctx, threads)
+
+    def start(self, threads=None):
+        # Starts optimizing every source on native threads and returns at
+        # once.  Until wait() returns, only progress(), cancel() and wait()
+        # may be used.
+        self.pathopt.path_optimize_start.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        if self.pathopt.path_optimize_start(self.ctx, threads if threads is not None else self.threads) < 0:
+            raise RuntimeError("An optimization is already running")
+
+    def progress(self):
+        # Sources done, sources in the run and paths added so far
+        self.pathopt.path_optimize_progress.argtypes = [ctypes.c_void_p, ctypes.POINTER(OptimizeProgress)]
+        progress = OptimizeProgress()
+        self.pathopt.path_optimize_progress(self.ctx, ctypes.byref(progress))
+        return {name: getattr(progress, name) for name, _ in OptimizeProgress._fields_}
+
+    def cancel(self):
+        # Stops the run once the sources in progress are done; a later
+        # start() picks up where it stopped
+        self.pathopt.path_optimize_cancel.argtypes = [ctypes.c_void_p]
+        self.pathopt.path_optimize_cancel(self.ctx)
+
+    def wait(self):
+        # Blocks (without holding the GIL) until the run ends; returns True
+        # if every source was optimized
+        self.pathopt.path_optimize_wait.argtypes = [ctypes.c_void_p]
+        completed = self.pathopt.path_optimize_wait(self.ctx)
+        if completed < 0:
+            raise RuntimeError("No optimization was started")
+        # After a cancelled run, front() and paths() finish the sources they need
+        self.optimized = self.optimized or completed == 1
+        return completed == 1
+
+    async def optimize_async(self, threads=None, interval=0.1, callback=None):
+        # Runs start() and waits for it without blocking the event loop,
+        # calling callback(progress()) every interval seconds.  Cancelling
+        # the task cancels the run.  Returns True if every source was optimized.
+        self.start(threads)
+        try:
+            while self.progress()["running"]:
+                if callback is not None:
+                    callback(self.progress())
+                await asyncio.sleep(interval)
+        except asyncio.CancelledError:
+            self.cancel()
+            self.wait()
+            raise
+        completed = self.wait()
+        if callback is not None:
+            callback(self.progress())
+        return completed
+
+    def stats(self):
+        # Hot path counters (zero unless created with stats=True), path pool
+        # usage and the time spent parsing, initializing, optimizing and writing
+        self.pathopt.pathopt_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(PathStats)]
+        self.pathopt.get_global_node_name_by_index.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        self.pathopt.get_global_node_name_by_index.restype = ctypes.c_char_p
+        stats = PathStats()
+        self.pathopt.pathopt_stats(self.ctx, ctypes.byref(stats))
+        result = {name: getattr(stats, name) for name, _ in PathStats._fields_ if name not in ("peak_srcid", "peak_dstid")}
+        result["peak_pair"] = None
+        if stats.peak_srcid >= 0:
+            result["peak_pair"] = (self.pathopt.get_global_node_name_by_index(self.ctx, stats.peak_srcid).decode('utf-8'),
+                                   self.pathopt.get_global_node_name_by_index(self.ctx, stats.peak_dstid).decode('utf-8'))
+        return result
+
+    def reset_stats(self):
+        # Zeros the counters and phase timers (not the path pool usage)
+        self.pathopt.pathopt_stats_reset.argtypes = [ctypes.c_void_p]
+        self.pathopt.pathopt_stats_reset(self.ctx)
 
-        # Optimize each pair one source at a time
-        nodecount = self.pathopt.global_node_count()
-        for i in range(nodecount):
-            self.pathopt.path_optimize_source_id(i)
+    def close(self):
+        # Frees the graph and the results; the object cannot be used afterwards
+        if self.ctx is not None:
+            self.pathopt.pathopt_destroy(self.ctx)
+            self.ctx = None
+
+    def __del__(self):
+        if getattr(self, "ctx", None) is not None:
+            self.close()
+
+    def query(self, srcname, dstname=None, outfile=None):
+        # Optimizes only the paths from srcname (to dstname if given) and
+        # writes them in the get_results format
+        self.pathopt.path_query.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p]
+        self.pathopt.write_query_paths.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int]
+        self.pathopt.get_global_node_id.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+        dst = dstname.encode('utf-8') if dstname is not None else None
+        srcid = self.pathopt.path_query(self.ctx, srcname.encode('utf-8'), dst)
+        if srcid < 0:
+            raise ValueError("Unknown node in query: %s -> %s" % (srcname, dstname))
+        dstid = self.pathopt.get_global_node_id(self.ctx, dst) if dst is not None else -1
+        self.pathopt.write_query_paths(self.ctx, outfile, srcid, dstid)
+
+    def front(self, srcname, dstname):
+        # Pareto optimal paths of a pair as flat arrays, without copying:
+        # values is a (paths x metrics) matrix of normalized values (multiply
+        # by self.signs for the real ones) and the node ids of path p are
+        # nodes[offsets[p]:offsets[p + 1]], source first.  The arrays point
+        # into the library and are only valid until the next front() or
+        # paths() call or change to the graph.
+        self.pathopt.path_front_export.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.POINTER(PathFront)]
+        self.pathopt.get_global_node_id.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+        if not self.optimized:
+            self.pathopt.path_query.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p]
+            self.pathopt.path_query(self.ctx, srcname.encode('utf-8'), dstname.encode('utf-8'))
+        srcid = self.pathopt.get_global_node_id(self.ctx, srcname.encode('utf-8'))
+        dstid = self.pathopt.get_global_node_id(self.ctx, dstname.encode('utf-8'))
+        front = PathFront()
+        if srcid < 0 or dstid < 0 or self.pathopt.path_front_export(self.ctx, srcid, dstid, ctypes.byref(front)) < 0:
+            raise ValueError("Unknown node in front: %s -> %s" % (srcname, dstname))
+        offsets = flat_view(front.offsets, ctypes.c_int, (front.count + 1,))
+        return (flat_view(front.values, ctypes.c_double, (front.count, front.metric_count)),
+                offsets,
+                flat_view(front.nodes, ctypes.c_int, (int(offsets[front.count]),)))
+
+    def paths(self, srcname, dstname):
+        # Pareto optimal paths of a pair as ({metric: value}, [node names])
+        self.pathopt.get_global_node_name_by_index.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        self.pathopt.get_global_node_name_by_index.restype = ctypes.c_char_p
+        values, offsets, nodes = self.front(srcname, dstname)
+        result = []
+        for path in range(len(offsets) - 1):
+            metrics = {name: values[path, i] * self.signs[i] for i, name in enumerate(self.metrics)}
+            names = [self.pathopt.get_global_node_name_by_index(self.ctx, int(nodeid)).decode('utf-8')
+                     for nodeid in nodes[offsets[path]:offsets[path + 1]]]
+            result.append((metrics, names))
+        return result
+
+    def update_edges(self, updates):
+        # Each update is (srcname, dstname, {metric: value}); metrics that
+        # are left out keep their current value.  Only the paths that depend
+        # on the changed edges are recomputed.
+        self.pathopt.path_update_edges.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_char_p),
+                                                   ctypes.POINTER(ctypes.c_char_p),
+                                                   ctypes.POINTER(ctypes.c_double), ctypes.c_int]
+        metric_total = self.pathopt.global_metric_count(self.ctx)
+        count = len(updates)
+        srcnames = (ctypes.c_char_p * count)()
+        dstnames = (ctypes.c_char_p * count)()
+        values = (ctypes.c_double * (count * metric_total))()
+        for i, (srcname, dstname, metrics) in enumerate(updates):
+            srcnames[i] = srcname.encode('utf-8')
+            dstnames[i] = dstname.encode('utf-8')
+            values[i * metric_total:(i + 1) * metric_total] = list(self.metric_values(metrics))
+        changed = self.pathopt.path_update_edges(self.ctx, count, srcnames, dstnames, values, self.threads)
+        if changed < 0:
+            raise ValueError("Unknown edge in update")
+        return changed
+
+    def update_edge(self, srcname, dstname, **metrics):
+        # Changes a single edge, e.g. po.update_edge("node1", "node2", delay=15)
+        return self.update_edges([(srcname, dstname, metrics)])
+
+    def metric_values(self, metrics):
+        # Metric values by ordinal, NaN for the ones that are left out
+        self.pathopt.get_global_metric_index.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+        metric_total = self.pathopt.global_metric_count(self.ctx)
+        values = (ctypes.c_double * metric_total)(*([math.nan] * metric_total))
+        for name, value in metrics.items():
+            index = self.pathopt.get_global_metric_index(self.ctx, name.encode('utf-8'))
+            if index < 0:
+                raise ValueError("Unknown metric: %s" % name)
+            values[index] = value
+        return values
+
+    def add_node(self, name, description=""):
+        # New nodes have no edges, so no paths change until edges are added
+        self.pathopt.path_add_node.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p]
+        if self.pathopt.path_add_node(self.ctx, name.encode('utf-8'), description.encode('utf-8')) < 0:
+            raise ValueError("Node already exists: %s" % name)
+
+    def remove_node(self, name):
+        # Removes the node with its edges and every path through it
+        self.pathopt.path_remove_node.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int]
+        if self.pathopt.path_remove_node(self.ctx, name.encode('utf-8'), self.threads) < 0:
+            raise ValueError("Unknown node: %s" % name)
+
+    def add_edge(self, srcname, dstname, **metrics):
+        # Adds an edge (or updates an existing one), e.g. po.add_edge("node1", "node2", cost=10)
+        self.pathopt.path_add_edge.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p,
+                                               ctypes.POINTER(ctypes.c_double), ctypes.c_int]
+        if self.pathopt.path_add_edge(self.ctx, srcname.encode('utf-8'), dstname.encode('utf-8'),
+                                      self.metric_values(metrics), self.threads) < 0:
+            raise ValueError("Unknown node in edge: %s -> %s" % (srcname, dstname))
+
+    def remove_edge(self, srcname, dstname):
+        # Removes an edge and every path over it
+        self.pathopt.path_remove_edge.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int]
+        if self.pathopt.path_remove_edge(self.ctx, srcname.encode('utf-8'), dstname.encode('utf-8'), self.threads) < 0:
+            raise ValueError("Unknown edge: %s -> %s" % (srcname, dstname))
 
     def get_results(self, outfile=None):
         # Output the results
         print("Generating Results")
-        self.pathopt.write_optimized_paths(outfile)
+        self.pathopt.write_optimized_paths.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+        self.pathopt.write_optimized_paths(self.ctx, outfile)
+
+    def write_results(self, filename):
+        # Writes the results to a binary result file (read it with PathResults)
+        self.pathopt.write_optimized_paths_binary.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+        if self.pathopt.write_optimized_paths_binary(self.ctx, filename.encode('utf-8')) < 0:
+            raise IOError("Could not write results: %s" % filename)
+
+class PathResults:
+    # Reads a binary result file written by "pathopt -b" or write_results.
+    # The file is mapped and its arrays are used in place.
+    def __init__(self, filename):
+        with open(filename, "rb") as f:
+            self.data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        (magic, version, byte_order, self.metric_count, self.node_count,
+         self.path_count, self.hop_count, file_size, names_offset, name_index_offset,
+         pairs_offset, paths_offset, nodes_offset, values_offset) = RESULTS_HEADER.unpack_from(self.data)
+        if magic != RESULTS_MAGIC or version != RESULTS_VERSION or byte_order != 0x01020304:
+            raise ValueError("Not a result file (or from another version or machine): %s" % filename)
+        if file_size != len(self.data):
+            raise ValueError("Truncated result file: %s" % filename)
+
+        # Names by metric ordinal and by node id
+        view = memoryview(self.data)
+        index = view[name_index_offset:name_index_offset + 4 * (self.metric_count + self.node_count)].cast("I")
+        names = [self.name(names_offset + offset) for offset in index]
+        self.metrics = names[:self.metric_count]
+        self.nodes = names[self.metric_count:]
+        self.node_ids = {name: nodeid for nodeid, name in enumerate(self.nodes)}
+
+        # Offset indexes, node ids and metric columns
+        self.pair_index = view[pairs_offset:pairs_offset + 8 * (self.node_count ** 2 + 1)].cast("Q")
+        self.path_index = view[paths_offset:paths_offset + 8 * (self.path_count + 1)].cast("Q")
+        self.path_nodes = view[nodes_offset:nodes_offset + 4 * self.hop_count].cast("i")
+        self.columns = [view[start:start + 8 * self.path_count].cast("d")
+                        for start in range(values_offset, values_offset + 8 * self.path_count * self.metric_count,
+                                           8 * self.path_count)]
+
+    def name(self, offset):
+        return self.data[offset:self.data.find(b"\0", offset)].decode('utf-8')
+
+    def paths(self, srcname, dstname):
+        # Pareto optimal paths of a pair as ({metric: value}, [node names])
+        pair = self.node_ids[srcname] * self.node_count + self.node_ids[dstname]
+        result = []
+        for path in range(self.pair_index[pair], self.pair_index[pair + 1]):
+            metrics = {name: self.columns[i][path] for i, name in enumerate(self.metrics)}
+            nodes = self.path_nodes[self.path_index[path]:self.path_index[path + 1]]
+            result.append((metrics, [self.nodes[nodeid] for nodeid in nodes]))
+        return result
+
+    def pairs(self):
+        # Every (srcname, dstname) pair that has paths
+        for pair in range(self.node_count ** 2):
+            if self.pair_index[pair] != self.pair_index[pair + 1]:
+                yield (self.nodes[pair // self.node_count], self.nodes[pair % self.node_count])
 
 ###################
 # Execute to Test #
@@ -2,10 +2,17 @@
 #include <stdlib.h>  // malloc, free
 #include <stdbool.h> // true, false
 #include <stdio.h>   // printf, stdin
+#include <math.h>    // isnan
+#include <pthread.h> // pthread_create, pthread_join
 
 #include "global.h"
 #include "metrics.h"
 #include "graph.h"
+#include "pool.h"
+#include "stats.h"
+#include "heap.h"
+#include "front.h"
+#include "dominance.h"
 #include "paths.h"
 
 /*************************
@@ -16,25 +23,29 @@
  * create_path - Create a path object with a single edge metric
  *
  * Arguments:
- *   srcname - Name of source node
- *   dstname - Name of destination node
- *
- * Creates the path object, initializes all the variables and returns the pointer.
- */
-path_struct *create_path(char *srcname, char *dstname) {
-  // Create path object
-  path_struct *new_path = malloc(sizeof(path_struct));
-  // Copy name values
-  strncpy(new_path->srcname, srcname, NAME_MAX_LENGTH);
-  strncpy(new_path->dstname, dstname, NAME_MAX_LENGTH);
-  // Create nodes
-  new_path->nodes = create_node(srcname);
-  new_path->nodes->next = create_node(dstname);
-  // Copy metrics
-  edge_struct *edge = get_global_edge(srcname, dstname);
-  new_path->metrics = copy_metrics(edge->metrics);
-  // Set next to null
-  new_path->next = NULL;
+ *   srcid - Id of source node
+ *   dstid - Id of destination node
+ *
+ * Creates the path object in the source's path pool, initializes all the
+ * variables and returns the pointer.  The caller owns the single reference
+ * to the new path.
+ */
+path_struct *create_path(pathopt_ctx *ctx, int srcid, int dstid) {
+  // Create path object with room for the metric vector
+  path_struct *new_path = pool_alloc(&ctx->path_pools[srcid]);
+  // Copy id values
+  new_path->srcid = srcid;
+  new_path->dstid = dstid;
+  new_path->length = 2;
+  new_path->refs = 1;
+  new_path->active = false;
+  new_path->expanded = false;
+  new_path->visited = VISITED_BIT(srcid) | VISITED_BIT(dstid);
+  // A direct path has no parent
+  new_path->parent = NULL;
+  // Copy metrics (the caller makes sure the edge exists)
+  edge_struct *edge = get_global_edge(ctx, srcid, dstid);
+  copy_metrics(ctx, new_path->metrics, edge->metrics);
   // Return the new path object
   return new_path;
 }
@@ -43,37 +54,32 @@ path_struct *create_path(char *srcname, char *dstname) {
  * extend_path - Creates a new path extending the source path
  *
  * Arguments:
- *   path - The source path the copy
- *   nodename - The name of the node to add to the end
- *
- * Takes a path and a node name and adds the node to the path.
- * It creates a new longer path and returns it.
- */
-path_struct *extend_path(path_struct *path, char *nodename) {
-  // Create path object
-  path_struct *new_path = malloc(sizeof(path_struct));
-  // Copy name values
-  strncpy(new_path->srcname, path->srcname, NAME_MAX_LENGTH);
-  strncpy(new_path->dstname, nodename, NAME_MAX_LENGTH);
-  // Copy source nodes
-  new_path->nodes = create_node(path->srcname);
-  node_struct *new_node = new_path->nodes;
-  for (node_struct *old_node = path->nodes; old_node != NULL; old_node = old_node->next) {
-    if (old_node->next != NULL) {
-      new_node->next = create_node(old_node->next->name);
-      new_node = new_node->next;
-    }
-  }
-  // Create temporary new edge variable
-  edge_struct *new_edge = get_global_edge(new_node->name, nodename);
+ *   path    - The source path the copy
+ *   nodeid  - The id of the node to add to the end
+ *   metrics - Metric vector of the edge from the end of the path to nodeid
+ *
+ * Takes a path and a node id and creates a new longer path that points back
+ * to the source path as its parent instead of copying its nodes, so the cost
+ * does not depend on the path length.  The new path holds a reference to its
+ * parent and the caller owns the single reference to the new path.
+ */
+path_struct *extend_path(pathopt_ctx *ctx, path_struct *path, int nodeid, double *metrics) {
+  if (ctx->stats_enabled) ctx->source_stats[path->srcid].extends++;
+  // Create path object with room for the metric vector
+  path_struct *new_path = pool_alloc(&ctx->path_pools[path->srcid]);
+  // Copy id values
+  new_path->srcid = path->srcid;
+  new_path->dstid = nodeid;
+  new_path->length = path->length + 1;
+  new_path->refs = 1;
+  new_path->active = false;
+  new_path->expanded = false;
+  new_path->visited = path->visited | VISITED_BIT(nodeid);
+  // Share the prefix
+  new_path->parent = path;
+  path->refs++;
   // Create and set the combined metrics
-  new_path->metrics = combine_metrics(path->metrics, new_edge->metrics);
-
-  // Add the additional node
-  new_node->next = create_node(nodename);
-
-  // Set next to null
-  new_path->next = NULL;
+  combine_metrics(ctx, new_path->metrics, path->metrics, metrics);
 
   // Return the new path
   return new_path;
@@ -81,34 +87,43 @@ path_struct *extend_path(path_struct *path, char *nodename) {
 
 
 /*
- * delete_path - Deletes a path object and related linked lists
+ * delete_path - Releases a reference to a path object
  *
  * Arguments:
  *   path - Path object to delete
  *
- * Deletes the path object and all related linked lists.  It does not follow the
- * next pointer to other paths.
+ * Drops one reference to the path.  When the last reference is gone the path
+ * object goes back to its source's path pool and its reference to the parent
+ * is released as well, so shared prefixes live as long as any path extending
+ * them.
  */
-void delete_path(path_struct *path) {
-  // Temp struct pointers
-  node_struct *temp1;
-  metric_struct *temp2;
-  // Delete nodes
-  while(path->nodes != NULL) {
-    temp1 = path->nodes;
-    path->nodes = temp1->next;
-    free(temp1);
+void delete_path(pathopt_ctx *ctx, path_struct *path) {
+  while(path != NULL && --path->refs == 0) {
+    path_struct *parent = path->parent;
+    // Return path object to the pool
+    pool_free(&ctx->path_pools[path->srcid], path);
+    path = parent;
   }
-  // Delete metrics
-  while(path->metrics != NULL) {
-    temp2 = path->metrics;
-    path->metrics = temp2->next;
-    free(temp2);
+}
+
+/*
+ * path_nodes - Rebuilds the node sequence of a path
+ *
+ * Arguments:
+ *   path  - The path object
+ *   nodes - Array with room for path->length node ids
+ *
+ * Walks the parent pointers from the tail back to the source and fills in
+ * the node ids in order from source to destination.  Returns the number of
+ * nodes written.
+ */
+int path_nodes(path_struct *path, int *nodes) {
+  int pos = path->length;
+  for(path_struct *current = path; current != NULL; current = current->parent) {
+    nodes[--pos] = current->dstid;
   }
-  // disconnect next (just in case)
-  path->next = NULL;
-  // Delete path object
-  free(path);
+  nodes[0] = path->srcid;
+  return path->length;
 }
 
 /*
@@ -122,28 +137,65 @@ void delete_path(path_struct *path) {
  *
  * Prints out the prefix, then the path nodes, then the postfix.
  */
-void display_path(FILE *outfile, char *prefix, path_struct *path, char *postfix) {
+void display_path(pathopt_ctx *ctx, FILE *outfile, char *prefix, path_struct *path, char *postfix) {
+  int *nodes = malloc(path->length * sizeof(int));
+  if (nodes == NULL) {
+    printf("Memory Allocation failed: display_path(%d)\n", path->length);
+    exit(1);
+  }
+  path_nodes(path, nodes);
   fprintf(outfile, "%s", prefix);
-  for (node_struct *current = path->nodes; current != NULL; current = current->next) {
-    fprintf(outfile, "%s", current->name);
-    if (current->next != NULL) fprintf(outfile, ",");
+  for (int i=0; i < path->length; i++) {
+    fprintf(outfile, "%s", get_global_node_name_by_index(ctx, nodes[i]));
+    if (i + 1 < path->length) fprintf(outfile, ",");
   }
   fprintf(outfile, "%s", postfix);
+  free(nodes);
 }
 
 /*
  * path_contains - Indicates if a node exists in a path
  *
  * Arguments:
- *   path - Path to search
- *   nodename - Node to search for
+ *   path   - Path to search
+ *   nodeid - Node id to search for
+ *
+ * Checks the path's visited signature first: if the node's bit is clear the
+ * node is not in the path.  With at most 64 nodes every node has its own bit,
+ * so a set bit is exact as well.  Otherwise it searchs back through the path's
+ * parents to determine if the nodeid node exists.  return true if found,
+ * otherwise it returns false.
+ */
+int path_contains(pathopt_ctx *ctx, path_struct *path, int nodeid) {
+  if ((path->visited & VISITED_BIT(nodeid)) == 0) return false;
+  if (ctx->global_node_total <= 64) return true;
+  if (path->srcid == nodeid) return true;
+  for(path_struct *current = path; current != NULL; current = current->parent) {
+    if (current->dstid == nodeid) return true;
+  }
+  return false;
+}
+
+/*
+ * path_uses_edge - Checks if a path goes over an edge
+ *
+ * Arguments:
+ *   path  - Path to search
+ *   srcid - Source node id of the edge
+ *   dstid - Destination node id of the edge
  *
- * Searchs through a path to determine if the nodename node exists.
- * return true if found, otherwise it returns false.
+ * A path visits each node at most once, so it uses the edge exactly when
+ * the node before dstid in the path is srcid.  Paths whose visited
+ * signature is missing either node are rejected without a walk.  Returns
+ * true if the path uses the edge, otherwise false.
  */
-int path_contains(path_struct *path, char *nodename) {
-  for(node_struct *curnode=path->nodes;curnode != NULL; curnode=curnode->next) {
-    if (strncmp(curnode->name, nodename, NAME_MAX_LENGTH) == 0) return true;
+int path_uses_edge(path_struct *path, int srcid, int dstid) {
+  unsigned long long bits = VISITED_BIT(srcid) | VISITED_BIT(dstid);
+  if ((path->visited & bits) != bits) return false;
+  for(path_struct *current = path; current != NULL; current = current->parent) {
+    if (current->dstid != dstid) continue;
+    int previd = (current->parent != NULL) ? (current->parent->dstid) : (current->srcid);
+    return previd == srcid;
   }
   return false;
 }
@@ -153,51 +205,151 @@ int path_contains(path_struct *path, char *nodename) {
  ********************/
 
 /*
- * new_path_collection - Create a path collection object
+ * init_path_collection - Initializes a path collection object
  *
  * Arguments:
- *   srcname - Source node name
- *   dstname - Destination node name
+ *   collection - Collection to initialize
+ *   srcid      - Source node id
+ *   dstid      - Destination node id
  *
- * Creates a single path_collection_struct with a single path entry for
- * the direct path.  Returns the created path_collection_struct object.
+ * Sets up an empty path_collection_struct.  The direct path, if there is an
+ * edge, is added by init_source_paths.
  */
-path_collection_struct *new_path_collection(char *srcname, char *dstname) {
-  // Create path collection object
-  path_collection_struct *newcollection = malloc(sizeof(path_collection_struct));
-  // Copy name values
-  strncpy(newcollection->srcname, srcname, NAME_MAX_LENGTH);
-  strncpy(newcollection->dstname, dstname, NAME_MAX_LENGTH);
-  // Create initial direct path
-  newcollection->optlist = create_path(srcname, dstname);
-  // Set next to null
-  newcollection->next = NULL;
-  // Return the new path collection
-  return newcollection;
+void init_path_collection(path_collection_struct *collection, int srcid, int dstid) {
+  // Copy id values
+  collection->srcid = srcid;
+  collection->dstid = dstid;
+  collection->paths = NULL;
+  collection->values = NULL;
+  collection->count = 0;
+  collection->capacity = 0;
+  collection->dirty = false;
 }
 
 /*
  * init_global_path_table - Initalizes the global path collection table
  *
  * Creates the initial path collection tables with a single direct connection
- * entry for each one.  At this point it should be ready for path expansion
- * exploration.
- */
-void init_global_path_table() {
-  // Set path hash table pointers to NULL
-  for(int i=0; i<HASH_SIZE; i++) path_hash_table[i] = NULL;
-
-  // path_collection_struct *path_hash_table[HASH_SIZE];
-  for(global_node_struct *srcnode=global_nodes; srcnode != NULL; srcnode=srcnode->next) {
-    for(global_node_struct *dstnode=global_nodes; dstnode != NULL; dstnode=dstnode->next) {
-      if (srcnode == dstnode) continue;
-      // Create the path collection
-      path_collection_struct *newcollection = new_path_collection(srcnode->name, dstnode->name);
-      // Put the path collection in the correct location in the hash table
-      unsigned int key = global_edge_hash_key(srcnode->name, dstnode->name);
-      newcollection->next = path_hash_table[key];
-      path_hash_table[key] = newcollection;
+ * entry for each one.  The table is indexed directly by node ids, one row of
+ * global_node_total collections per source.  At this point it should be ready
+ * for path expansion exploration.
+ */
+void init_global_path_table(pathopt_ctx *ctx) {
+  init_path_table(ctx);
+  for(int srcid=0; srcid < ctx->global_node_total; srcid++) init_source_paths(ctx, srcid);
+}
+
+/*
+ * init_path_table - Creates an empty path collection table
+ *
+ * Chooses the front kernel for the graph and creates one path pool per
+ * source, but leaves every source's row of collections unallocated (NULL)
+ * until init_source_paths sets it up.  Queries only pay for the sources
+ * they ask about.
+ */
+void init_path_table(pathopt_ctx *ctx) {
+  double started = stats_clock();
+  // Choose the front kernel for this graph
+  front_configure(ctx);
+
+  // Create one path pool and one set of counters per source
+  ctx->path_pools = malloc((ctx->global_node_total > 0 ? ctx->global_node_total : 1) * sizeof(pool_struct));
+  ctx->path_table = calloc((ctx->global_node_total > 0 ? ctx->global_node_total : 1), sizeof(path_collection_struct *));
+  ctx->source_stats = calloc((ctx->global_node_total > 0 ? ctx->global_node_total : 1), sizeof(source_stats_struct));
+  if (ctx->path_pools == NULL || ctx->path_table == NULL || ctx->source_stats == NULL) {
+    printf("Memory Allocation failed: init_path_table(%d)\n", ctx->global_node_total);
+    exit(1);
+  }
+  for(int i=0; i < ctx->global_node_total; i++) {
+    pool_init(&ctx->path_pools[i], sizeof(path_struct) + ctx->global_metric_total * sizeof(double), POOL_BLOCK_OBJECTS);
+  }
+  ctx->phase_seconds[PHASE_INIT] += stats_clock() - started;
+}
+
+/*
+ * init_source_paths - Creates a source's row of path collections
+ *
+ * Arguments:
+ *   srcid - Source node id
+ *
+ * Every collection starts out empty, then the direct paths are added from
+ * the source's CSR out-edges, so the cost is one row plus the source's
+ * degree rather than a lookup per destination.
+ */
+void init_source_paths(pathopt_ctx *ctx, int srcid) {
+  double started = stats_clock();
+  path_collection_struct *row = malloc((ctx->global_node_total > 0 ? ctx->global_node_total : 1) * sizeof(path_collection_struct));
+  if (row == NULL) {
+    printf("Memory Allocation failed: init_source_paths(%d)\n", ctx->global_node_total);
+    exit(1);
+  }
+  for(int dstid=0; dstid < ctx->global_node_total; dstid++) init_path_collection(&row[dstid], srcid, dstid);
+  ctx->path_table[srcid] = row;
+  for(int edge=ctx->adj_offsets[srcid]; edge < ctx->adj_offsets[srcid + 1]; edge++) {
+    int dstid = ctx->adj_targets[edge];
+    if (dstid != srcid) front_insert(ctx, &row[dstid], create_path(ctx, srcid, dstid));
+  }
+  ctx->phase_seconds[PHASE_INIT] += stats_clock() - started;
+}
+
+/*
+ * release_source_paths - Releases every path from a source at once
+ *
+ * Arguments:
+ *   srcid - Source node id
+ *
+ * Empties all the (srcid, *) collections and frees the source's path pool
+ * in one step instead of deleting the paths one by one.
+ */
+void release_source_paths(pathopt_ctx *ctx, int srcid) {
+  for(int dstid=0; dstid < ctx->global_node_total && ctx->path_table[srcid] != NULL; dstid++) {
+    if (srcid == dstid) continue;
+    path_collection_lookup(ctx, srcid, dstid)->count = 0;
+  }
+  pool_release(&ctx->path_pools[srcid]);
+}
+
+/*
+ * free_global_path_table - Frees the global path collection table
+ *
+ * Releases every source's path pool and frees the path collections.
+ */
+void free_global_path_table(pathopt_ctx *ctx) {
+  for(int i=0; i < ctx->global_node_total && ctx->path_table != NULL; i++) {
+    for(int j=0; j < ctx->global_node_total && ctx->path_table[i] != NULL; j++) {
+      free(ctx->path_table[i][j].paths);
+      free(ctx->path_table[i][j].values);
     }
+    free(ctx->path_table[i]);
+  }
+  for(int i=0; i < ctx->global_node_total && ctx->path_pools != NULL; i++) pool_release(&ctx->path_pools[i]);
+  free(ctx->path_table);
+  free(ctx->path_pools);
+  free(ctx->source_stats);
+  free(ctx->export_offsets);
+  free(ctx->export_nodes);
+  ctx->path_table = NULL;
+  ctx->path_pools = NULL;
+  ctx->source_stats = NULL;
+  ctx->export_offsets = NULL;
+  ctx->export_nodes = NULL;
+  ctx->export_offsets_capacity = 0;
+  ctx->export_nodes_capacity = 0;
+}
+
+/*
+ * path_pool_stats - Reports path pool usage over all sources
+ *
+ * Arguments:
+ *   allocations - Set to the number of path objects handed out
+ *   peak_bytes  - Set to the sum of the pools' peak block memory
+ */
+void path_pool_stats(pathopt_ctx *ctx, unsigned long *allocations, size_t *peak_bytes) {
+  *allocations = 0;
+  *peak_bytes = 0;
+  for(int i=0; i < ctx->global_node_total && ctx->path_pools != NULL; i++) {
+    *allocations += ctx->path_pools[i].allocations;
+    *peak_bytes += ctx->path_pools[i].peak_bytes;
   }
 }
 
@@ -210,35 +362,16 @@ void init_global_path_table() {
  *
  * Returns true if path dominates the other path.  Otherwise returns false.
  */
-int dominates_path(path_struct *path, path_struct *other) {
-  int better = 0;
-  int worse = 0;
-
+int dominates_path(pathopt_ctx *ctx, path_struct *path, path_struct *other) {
   // A path cannot dominate itself
   if (path == other) return false;
+  if (ctx->stats_enabled) ctx->source_stats[other->srcid].dominance_checks++;
 
-  // for loop through global metrics list
-  for (global_metric_struct *gms = global_metrics; gms != NULL; gms = gms->next) {
-    // Get values
-    double value1, value2;
-    value1 = get_metric_value(path->metrics, gms->name);
-    value2 = get_metric_value(other->metrics, gms->name);
-
-    // Optimizer comparison
-    if (gms->opt == OPT_MAX) {
-      if (value1 > value2) better++;
-      if (value1 < value2) worse++;
-    }
-    if (gms->opt == OPT_MIN) {
-      if (value1 < value2) better++;
-      if (value1 > value2) worse++;
-    }
-  }
-
-  if (better > 0 && worse == 0) {
+  // Compare the normalized metric vectors
+  if (dominates_vector(path->metrics, other->metrics, ctx->global_metric_total)) {
     if (DEBUG) {
-      display_metrics(stdout, "Path1: ", path->metrics, " dominates ");
-      display_metrics(stdout, "Path2: ", other->metrics, "\n");
+      display_metrics(ctx, stdout, "Path1: ", path->metrics, " dominates ");
+      display_metrics(ctx, stdout, "Path2: ", other->metrics, "\n");
     }
     return true;
   }
@@ -255,20 +388,37 @@ int dominates_path(path_struct *path, path_struct *other) {
  * Checks the nodes and returns true if they match in the same order.
  */
 int duplicate_path(path_struct *first, path_struct *second) {
-  // Set nodes to the start of the list
-  node_struct *node1 = first->nodes;
-  node_struct *node2 = second->nodes;
-  // Walk through the nodes comparing them
-  while(node1 != NULL && node2 != NULL) {
-    if (strncmp(node1->name, node2->name, NAME_MAX_LENGTH) == 0) {
-      node1 = node1->next;
-      node2 = node2->next;
-    } else return false;
-  }
-  // See if we broke because both matched the whole way
-  if (node1 == NULL && node2 == NULL) return true;
-  // I guess only one was NULL, so no match
-  return false;
+  // Paths of different length cannot match
+  if (first->srcid != second->srcid || first->length != second->length) return false;
+  // Walk back through the parents comparing the nodes until the prefix is shared
+  while(first != second) {
+    if (first->dstid != second->dstid) return false;
+    first = first->parent;
+    second = second->parent;
+  }
+  return true;
+}
+
+/*
+ * compare_paths_lex - Orders two paths lexicographically on their metrics
+ *
+ * Arguments:
+ *   first  - First path to compare
+ *   second - Second path to compare
+ *
+ * Compares the normalized metric vectors by ordinal, so the better value
+ * comes first for every metric.  Returns a negative number if
+ * first comes before second, a positive number if after and 0 if the vectors
+ * are equal.  A path can only be dominated by paths that come before it.
+ */
+int compare_paths_lex(pathopt_ctx *ctx, path_struct *first, path_struct *second) {
+  for (int i=0; i < ctx->global_metric_total; i++) {
+    double value1 = first->metrics[i];
+    double value2 = second->metrics[i];
+    if (value1 == value2) continue;
+    return (value1 < value2) ? (-1) : (1);
+  }
+  return 0;
 }
 
 /*
@@ -277,55 +427,28 @@ int duplicate_path(path_struct *first, path_struct *second) {
  * Arguments:
  *   collection - Path collection to clean up
  *
- * Looks through all the paths in the optimized list and sees
- * if any are now dominated.  If they are dominated, they are removed.
- * The number of paths removed is returned.
+ * Looks through all the paths in the front and sees if any are now
+ * dominated.  If they are dominated, they are removed.  Since a path can
+ * only be dominated by paths earlier in the sorted front, a single pass is
+ * enough.  add_path_attempt already evicts dominated paths, so this only
+ * finds something if the front was changed by other means.  The number of
+ * paths removed is returned.
  */
-int clear_dominated_paths(path_collection_struct *collection) {
+int clear_dominated_paths(pathopt_ctx *ctx, path_collection_struct *collection) {
   int removed = 0;
-  int restart = false;
 
-  // Do this loop as long as we keep removing paths
-  do {
-    restart = false;
-    // Iterate through the list of paths
-    for(path_struct *current=collection->optlist; current!=NULL; current=current->next) {
-      // See if any of the other paths dominates this one.
-      for(path_struct *test=collection->optlist; test!=NULL; test=test->next) {
-	if (current == test) continue; // Cannot dominate itself
-
-	if (dominates_path(test, current)) {
-	  // Remove current from the list.
-	  path_struct *listend = current->next; // Everything after the path to delete
-
-	  // Remove if collection is the front path
-	  if (collection->optlist == current) {
-	    collection->optlist = listend;
-	    delete_path(current); // delete path
-	    removed++;
-	  } else {
-	    // Remove in the middle
-	    path_struct *check = collection->optlist;
-	    while(check != NULL) {
-	      if (check->next == current) {
-		check->next = listend;
-		delete_path(current); // delete path
-		removed++;
-		break;
-	      } else {
-		check = check->next;
-	      }
-	    }
-	  }
-	  // Indicate we need to start the search over
-	  restart = true;
-	  break;
-	} // End of dominatated path discovery
+  for(int i=0; i < collection->count; i++) {
+    for(int j=0; j < i; j++) {
+      if (dominates_path(ctx, collection->paths[j], collection->paths[i])) {
+	front_remove(ctx, collection, i);
+	removed++;
+	i--;
+	break;
       }
-      if (restart) break;
     }
-  } while(restart);
+  }
 
+  if (ctx->stats_enabled) ctx->source_stats[collection->srcid].evictions += removed;
   return removed;
 }
 
@@ -337,123 +460,855 @@ int clear_dominated_paths(path_collection_struct *collection) {
  *   path - The path to attempt to add to the collection
  *
  * Tries to add the path to the collection.  If the path is not dominated
- * by any other paths in the collection, it is added and the value 1
- * is returned.  If it is not added, the number 0 is returned.
+ * by any other paths in the collection, it is added, any paths it dominates
+ * are removed and the value 1 is returned.  If it is not added, the number
+ * 0 is returned.
  */
-int add_path_attempt(path_collection_struct *collection, path_struct *path) {
+int add_path_attempt(pathopt_ctx *ctx, path_collection_struct *collection, path_struct *path) {
   if (collection == NULL) fprintf(stderr, "Error: Collection is NULL.  Cannot add path!\n");
   if (path == NULL) fprintf(stderr, "Error: Path is NULL.  Cannot add to collection!\n");
 
-  // See if any of the paths dominate the path, or it is in the collection
-  for(path_struct *current=collection->optlist; current!=NULL; current=current->next) {
-    if (dominates_path(current, path)) return 0; // Domination check
-    if (duplicate_path(current, path)) return 0; // Duplicate check
+  int added = front_insert(ctx, collection, path);
+  if (ctx->stats_enabled) {
+    source_stats_struct *stats = &ctx->source_stats[collection->srcid];
+    if (added) stats->accepts++;
+    else stats->rejects++;
+    if (collection->count > stats->peak_front) {
+      stats->peak_front = collection->count;
+      stats->peak_dstid = collection->dstid;
+    }
   }
+  return added;
+}
 
-  // Add the path if not dominated
-  path->next = collection->optlist;
-  collection->optlist = path;
-
-  // Return 1 because the path was added
-  return 1;
+/*
+ * path_optimize_source - Tries to optimize all routes starting with the source
+ *
+ * Arguments:
+ *   srcname - Source node to start optimizing from
+ *
+ * Looks up the node id and calls the path_optimize_source_id function using the
+ * srcnode id instead of the name.
+ */
+void path_optimize_source(pathopt_ctx *ctx, char *srcname) {
+  int srcid = get_global_node_id(ctx, srcname);
+  if (srcid == ERROR) {
+    fprintf(stderr, "Error: Unknown source node \"%s\"\n", srcname);
+    return;
+  }
+  path_optimize_source_id(ctx, srcid);
 }
 
+
 /*
  * path_optimize_source_id - Tries to optimize all routes starting with the source by id
  *
  * Arguments:
- *   id - Global node name index id
+ *   srcid - Global node id of the source node
  *
- * Looks up the node name and calls the path_optimize_source function using the srcnode
- * name instead of the id.
+ * Runs the engine selected by optimize_engine.  Both engines reach the same
+ * non-dominated paths.  Sources whose row was never set up are skipped.
+ * Returns the number of paths added to fronts.
  */
-void path_optimize_source_id(int id) {
-  char *nodename = get_global_node_name_by_index(id);
-  path_optimize_source(nodename);
+int path_optimize_source_id(pathopt_ctx *ctx, int srcid) {
+  if (ctx->path_table[srcid] == NULL) return 0; // Not set up (see path_query)
+  if (ctx->optimize_engine == ENGINE_LABEL) return path_optimize_source_label(ctx, srcid);
+  return path_optimize_source_rounds(ctx, srcid);
 }
 
-
 /*
- * path_optimize_source - Tries to optimize all routes starting with the source
+ * path_optimize_source_rounds - Optimizes all routes from the source in rounds
  *
  * Arguments:
- *   srcname - Source node to start optimizing from
+ *   srcid - Global node id of the source node
+ *
+ * Loops through every relay path from the source and extends it along each
+ * of the relay's real out-edges (from the CSR adjacency), trying to add the
+ * result to the destination's collection.  It stops when it is able to run
+ * through a complete round without finding any new optimized paths.
  *
- * Loops through all destinations and tries to optimize the path between the
- * pair.  It stops when it is able to run through a complete set of destinations
- * without finding any new optimized paths.
+ * Work is semi-naive: a path is only extended once (the expanded flag),
+ * and relays whose collection has not changed since their last visit (the
+ * dirty flag) are skipped without looking at their paths.  Returns the
+ * number of paths added to fronts.
  */
-void path_optimize_source(char *srcname) {
-  if (DEBUG) printf("Optimizing Source %s\n", srcname);
-  int changes = 0, status;
+int path_optimize_source_rounds(pathopt_ctx *ctx, int srcid) {
+  if (DEBUG) printf("Optimizing Source %s\n", get_global_node_name_by_index(ctx, srcid));
+  int changes = 0, status, added = 0;
   int round = 0;
 
-  // Process all destinations from source until no new paths are found
+  // Process all relays from source until no new paths are found
   do {
     round++;
     changes = 0;
 
-    for(global_node_struct *dstnode=global_nodes; dstnode != NULL; dstnode=dstnode->next) {
-      // Source and destination cannot be the same
-      if (strncmp(srcname, dstnode->name, NAME_MAX_LENGTH) == 0) continue;
-      // Load the path collection
-      path_collection_struct *collection = path_collection_lookup(srcname, dstnode->name);
-
-      // Try adding this path's dstname to all other non-dominated lists
-      // for other destinations and see if they create non-dominated paths.
-      for(global_node_struct *relay=global_nodes; relay != NULL; relay=relay->next) {
-	// Skip invalid relay nodes
-	if (strncmp(srcname, relay->name, NAME_MAX_LENGTH) == 0) continue;       // Cannot use source as relay
-	if (strncmp(dstnode->name, relay->name, NAME_MAX_LENGTH) == 0) continue; // Cannot use destation as relay
-
-	// Load relay collection to attempt to add the destination node
-	path_collection_struct *relay_collection = path_collection_lookup(srcname, relay->name);
-	for (path_struct *relaypath=relay_collection->optlist; relaypath != NULL; relaypath=relaypath->next) {
-	  // Do not attempt to add destination node if in path
-	  if (path_contains(relaypath, dstnode->name)) continue;
+    for(int relayid=0; relayid < ctx->global_node_total; relayid++) {
+      // Cannot use source as relay
+      if (srcid == relayid) continue;
+
+      // Load relay collection, skipping it if nothing was added since the last visit
+      path_collection_struct *relay_collection = path_collection_lookup(ctx, srcid, relayid);
+      if (!relay_collection->dirty) continue;
+      relay_collection->dirty = false;
+
+      // Try each of its new paths on each out-edge
+      for (int i=0; i < relay_collection->count; i++) {
+	path_struct *relaypath = relay_collection->paths[i];
+	if (relaypath->expanded) continue;
+	relaypath->expanded = true;
+	for (int edge=ctx->adj_offsets[relayid]; edge < ctx->adj_offsets[relayid + 1]; edge++) {
+	  int dstid = ctx->adj_targets[edge];
+	  // Do not attempt to add destination node if in path (includes source)
+	  if (path_contains(ctx, relaypath, dstid)) continue;
+	  // Load the destination path collection
+	  path_collection_struct *collection = path_collection_lookup(ctx, srcid, dstid);
 	  // Create trial path
-	  path_struct *trial_path = extend_path(relaypath, dstnode->name);
-	  if (DEBUG) display_path(stdout, "Attempting to add ", trial_path, "\n");
-	  status = add_path_attempt(collection, trial_path);
+	  path_struct *trial_path = extend_path(ctx, relaypath, dstid, ctx->adj_metrics + edge * ctx->global_metric_total);
+	  if (DEBUG) display_path(ctx, stdout, "Attempting to add ", trial_path, "\n");
+	  status = add_path_attempt(ctx, collection, trial_path); // Also evicts newly dominated paths
 	  changes += status; // Update the changes
-	  if (status == 0) delete_path(trial_path); // Delete if not used
-	  else changes += clear_dominated_paths(collection); // Delete any newly dominated paths
+	  if (status == 0) delete_path(ctx, trial_path); // Delete if not used
 	}
       }
-
-      // Clear any now dominated paths
-      changes += clear_dominated_paths(collection);
     }
 
     if (DEBUG) printf("Round %d - Changes: %d\n", round, changes);
+    added += changes;
   } while(changes > 0);
+
+  if (ctx->stats_enabled) ctx->source_stats[srcid].rounds += round;
+  return added;
 }
 
 /*
- * path_collection_lookup - Lookup a path collection object
+ * path_optimize_source_label - Optimizes all routes from the source by label setting
+ *
+ * Arguments:
+ *   srcid - Global node id of the source node
+ *
+ * Martins-style multi-objective label setting.  Every non-dominated path is
+ * kept in a heap ordered lexicographically on its metrics, and each one is
+ * extended along its tail's out-edges exactly once when it is popped.  Paths
+ * that were evicted from their collection while waiting in the heap are
+ * dropped without being extended, since whatever evicted them extends to
+ * paths that dominate theirs.  Returns the number of paths added to fronts.
+ */
+int path_optimize_source_label(pathopt_ctx *ctx, int srcid) {
+  return path_optimize_source_bounded(ctx, srcid, ERROR);
+}
+
+/*
+ * path_optimize_source_bounded - Label setting towards a single destination
+ *
+ * Arguments:
+ *   srcid - Global node id of the source node
+ *   dstid - Destination to bound the search with, or ERROR for none
+ *
+ * path_optimize_source_label with destination bounds: when every metric is
+ * monotone (front_monotone), a path that is strictly dominated by a path
+ * already in the destination's collection can only extend to dominated
+ * paths, so it is not extended, and paths that reach the destination are
+ * not extended either.  Only the (srcid, dstid) collection is complete
+ * afterwards.  Skipped paths stay unexpanded, so running the source again
+ * without a bound finishes the rest of the row.  Returns the number of
+ * paths added to fronts.
+ */
+int path_optimize_source_bounded(pathopt_ctx *ctx, int srcid, int dstid) {
+  if (DEBUG) printf("Optimizing Source %s (label setting)\n", get_global_node_name_by_index(ctx, srcid));
+  path_collection_struct *target = (dstid != ERROR && ctx->front_monotone) ? (path_collection_lookup(ctx, srcid, dstid)) : (NULL);
+  path_heap_struct heap;
+  path_struct *path;
+  int labels = 0, added = 0;
+
+  // Start from the paths not extended yet (the direct paths in a new table)
+  heap_init(&heap);
+  for(int relayid=0; relayid < ctx->global_node_total; relayid++) {
+    if (srcid == relayid) continue;
+    path_collection_struct *collection = path_collection_lookup(ctx, srcid, relayid);
+    for(int i=0; i < collection->count; i++) {
+      if (!collection->paths[i]->expanded) heap_push(ctx, &heap, collection->paths[i]);
+    }
+  }
+
+  // Extend the smallest label until none are left
+  while ((path = heap_pop(ctx, &heap)) != NULL) {
+    int pending = (path->active && !path->expanded);
+    int bounded = (pending && target != NULL &&
+		   (path->dstid == dstid || dominance_find(target->values, target->count, ctx->global_metric_total, path->metrics) < target->count));
+    if (pending && !bounded) {
+      path->expanded = true;
+      labels++;
+      int relayid = path->dstid;
+      for (int edge=ctx->adj_offsets[relayid]; edge < ctx->adj_offsets[relayid + 1]; edge++) {
+	int nextid = ctx->adj_targets[edge];
+	// Do not attempt to add destination node if in path (includes source)
+	if (path_contains(ctx, path, nextid)) continue;
+	// Create trial path
+	path_collection_struct *collection = path_collection_lookup(ctx, srcid, nextid);
+	path_struct *trial_path = extend_path(ctx, path, nextid, ctx->adj_metrics + edge * ctx->global_metric_total);
+	if (DEBUG) display_path(ctx, stdout, "Attempting to add ", trial_path, "\n");
+	if (add_path_attempt(ctx, collection, trial_path)) {
+	  added++;
+	  heap_push(ctx, &heap, trial_path); // Extend it once its turn comes
+	} else {
+	  delete_path(ctx, trial_path); // Delete if not used
+	}
+      }
+    } else if (bounded) {
+      path_collection_lookup(ctx, srcid, path->dstid)->dirty = true; // Left for a later unbounded run
+    }
+    delete_path(ctx, path); // Release the heap reference
+  }
+  heap_free(ctx, &heap);
+
+  if (DEBUG) printf("Labels extended: %d\n", labels);
+  if (ctx->stats_enabled) ctx->source_stats[srcid].labels += labels;
+  return added;
+}
+
+/*
+ * path_optimize_worker - Thread body for path_optimize_all
+ *
+ * Arguments:
+ *   arg - Pointer to the shared optimize_queue_struct
+ *
+ * Takes the next unclaimed source id from the queue and optimizes it until
+ * every source has been claimed or the run is cancelled, adding each source
+ * to the context's progress as it finishes.
+ */
+void *path_optimize_worker(void *arg) {
+  optimize_queue_struct *queue = arg;
+  pathopt_ctx *ctx = queue->ctx;
+  while (true) {
+    pthread_mutex_lock(&queue->lock);
+    int srcid = queue->next++;
+    pthread_mutex_unlock(&queue->lock);
+    if (srcid >= ctx->global_node_total) break;
+
+    pthread_mutex_lock(&ctx->progress_lock);
+    int cancelled = ctx->progress.cancelled;
+    pthread_mutex_unlock(&ctx->progress_lock);
+    if (cancelled) break;
+
+    int added = path_optimize_source_id(ctx, srcid);
+    pthread_mutex_lock(&ctx->progress_lock);
+    ctx->progress.sources_done++;
+    ctx->progress.paths += added;
+    pthread_mutex_unlock(&ctx->progress_lock);
+  }
+  return NULL;
+}
+
+/*
+ * path_optimize_reset - Starts the progress of a new run
+ *
+ * Arguments:
+ *   running - True if the run is starting now
+ */
+void path_optimize_reset(pathopt_ctx *ctx, int running) {
+  pthread_mutex_lock(&ctx->progress_lock);
+  ctx->progress.sources_done = 0;
+  ctx->progress.source_total = ctx->global_node_total;
+  ctx->progress.paths = 0;
+  ctx->progress.running = running;
+  ctx->progress.cancelled = false;
+  pthread_mutex_unlock(&ctx->progress_lock);
+}
+
+/*
+ * path_optimize_run - Optimizes every source, optionally on several threads
  *
  * Arguments:
- *   srcname - Name of the source node
- *   dstname - Name of the destination node
+ *   threads - Number of worker threads (1 or less runs on this thread)
  *
- * Look through the path collection hash table and find the path
- * collection object that contains the list of non-dominated
- * paths for that source/destination pair.
+ * The body of path_optimize_all without the progress reset, so a run that
+ * path_optimize_start began can be cancelled before its thread gets here.
  */
-path_collection_struct *path_collection_lookup(char *srcname, char *dstname) {
-  // Find the correct hash bucket
-  unsigned int key = global_edge_hash_key(srcname, dstname);
-  // Look down the list for the collection object
-  path_collection_struct *collection = path_hash_table[key];
-  while(collection != NULL) {
-    if (strncmp(collection->srcname, srcname, NAME_MAX_LENGTH) == 0 &&
-        strncmp(collection->dstname, dstname, NAME_MAX_LENGTH) == 0) return collection;
-    collection = collection->next;
+void path_optimize_run(pathopt_ctx *ctx, int threads) {
+  optimize_queue_struct queue;
+  queue.ctx = ctx;
+  queue.next = 0;
+  pthread_mutex_init(&queue.lock, NULL);
+
+  // Set up the rows path_query never got to
+  if (ctx->path_table == NULL) init_path_table(ctx);
+  for (int i=0; i < ctx->global_node_total; i++) {
+    if (ctx->path_table[i] == NULL) init_source_paths(ctx, i);
   }
-  fprintf(stderr, "Error: Could not find path collection!\n");
+
+  double started = stats_clock();
+  if (threads > ctx->global_node_total) threads = ctx->global_node_total;
+  if (threads <= 1) {
+    path_optimize_worker(&queue);
+  } else {
+    pthread_t workers[threads];
+    for (int i=0; i < threads; i++) {
+      if (pthread_create(&workers[i], NULL, path_optimize_worker, &queue) != 0) {
+	fprintf(stderr, "Error: Could not create worker thread %d\n", i);
+	exit(1);
+      }
+    }
+    for (int i=0; i < threads; i++) pthread_join(workers[i], NULL);
+  }
+  pthread_mutex_destroy(&queue.lock);
+  ctx->phase_seconds[PHASE_OPTIMIZE] += stats_clock() - started;
+
+  pthread_mutex_lock(&ctx->progress_lock);
+  ctx->progress.running = false;
+  pthread_mutex_unlock(&ctx->progress_lock);
+}
+
+/*
+ * path_optimize_all - Optimizes every source, optionally on several threads
+ *
+ * Arguments:
+ *   threads - Number of worker threads (1 or less runs serially)
+ *
+ * Each source only touches its own (src, *) collections and its own path
+ * pool, and the collection table and graph are only read, so sources can
+ * be optimized in parallel.  The results are the same as a serial run.
+ * Rows path_query never set up are set up first.  Progress is kept in the
+ * context (see path_optimize_progress).
+ */
+void path_optimize_all(pathopt_ctx *ctx, int threads) {
+  path_optimize_reset(ctx, true);
+  path_optimize_run(ctx, threads);
+}
+
+/*
+ * path_optimize_thread - Thread body for path_optimize_start
+ *
+ * Arguments:
+ *   arg - The context to optimize
+ */
+void *path_optimize_thread(void *arg) {
+  pathopt_ctx *ctx = arg;
+  path_optimize_run(ctx, ctx->optimize_threads);
   return NULL;
 }
 
+/*
+ * path_optimize_start - Starts path_optimize_all in the background
+ *
+ * Arguments:
+ *   threads - Number of worker threads (1 or less uses one)
+ *
+ * Runs path_optimize_all on its own thread and returns at once.  While it
+ * runs only path_optimize_progress, path_optimize_cancel and
+ * path_optimize_wait may be called on the context.  Returns 0, or ERROR if
+ * a run is already started and not waited for.
+ */
+int path_optimize_start(pathopt_ctx *ctx, int threads) {
+  if (ctx->optimize_started) return ERROR;
+  path_optimize_reset(ctx, true);
+  ctx->optimize_threads = threads;
+  if (pthread_create(&ctx->optimize_thread, NULL, path_optimize_thread, ctx) != 0) {
+    fprintf(stderr, "Error: Could not create optimizer thread\n");
+    exit(1);
+  }
+  ctx->optimize_started = true;
+  return 0;
+}
+
+/*
+ * path_optimize_progress - Reports how far the current or last run got
+ *
+ * Arguments:
+ *   progress - Filled in with a copy of the run's progress
+ *
+ * Safe to call from any thread while a run is in progress.
+ */
+void path_optimize_progress(pathopt_ctx *ctx, optimize_progress_struct *progress) {
+  pthread_mutex_lock(&ctx->progress_lock);
+  *progress = ctx->progress;
+  pthread_mutex_unlock(&ctx->progress_lock);
+}
+
+/*
+ * path_optimize_cancel - Asks a run to stop
+ *
+ * Safe to call from any thread.  The workers finish the sources they are on
+ * and claim no more, so every source is either fully optimized or left as
+ * it was.  Running path_optimize_all (or path_optimize_start) again later
+ * picks up where the run stopped.  Does nothing if no run is in progress.
+ */
+void path_optimize_cancel(pathopt_ctx *ctx) {
+  pthread_mutex_lock(&ctx->progress_lock);
+  if (ctx->progress.running) ctx->progress.cancelled = true;
+  pthread_mutex_unlock(&ctx->progress_lock);
+}
+
+/*
+ * path_optimize_wait - Waits for a path_optimize_start run to end
+ *
+ * Returns 1 if every source was optimized, 0 if the run was cancelled or
+ * ERROR if no run was started.
+ */
+int path_optimize_wait(pathopt_ctx *ctx) {
+  if (!ctx->optimize_started) return ERROR;
+  pthread_join(ctx->optimize_thread, NULL);
+  ctx->optimize_started = false;
+  return (ctx->progress.sources_done == ctx->progress.source_total);
+}
+
+/*
+ * path_query - Optimizes the paths from one source, or for one pair
+ *
+ * Arguments:
+ *   srcname - Source node name
+ *   dstname - Destination node name, or NULL for every destination
+ *
+ * Sets up only what the query needs: the path table (without any rows) the
+ * first time, then the source's own row, and runs the source.  With a
+ * destination the search is bounded by the destination's collection (see
+ * path_optimize_source_bounded) whenever the metrics allow it, so the work
+ * follows the part of the graph that can still improve that pair.  Results
+ * are read from path_collection_lookup or written with write_query_paths.
+ * Returns the source's id, or ERROR if a node is unknown.
+ */
+int path_query(pathopt_ctx *ctx, char *srcname, char *dstname) {
+  int srcid = get_global_node_id(ctx, srcname);
+  int dstid = (dstname != NULL) ? (get_global_node_id(ctx, dstname)) : (ERROR);
+  if (srcid == ERROR || (dstname != NULL && dstid == ERROR)) {
+    fprintf(stderr, "Error: Unknown node in query \"%s\" -> \"%s\"\n", srcname, (dstname != NULL) ? (dstname) : (""));
+    return ERROR;
+  }
+
+  if (ctx->path_table == NULL) init_path_table(ctx);
+  if (ctx->path_table[srcid] == NULL) init_source_paths(ctx, srcid);
+  double started = stats_clock();
+  if (dstid != ERROR && dstid != srcid) path_optimize_source_bounded(ctx, srcid, dstid);
+  else path_optimize_source_id(ctx, srcid);
+  ctx->phase_seconds[PHASE_OPTIMIZE] += stats_clock() - started;
+  return srcid;
+}
+
+/*
+ * path_repair_source - Undoes the effect of changed edges on one source
+ *
+ * Arguments:
+ *   srcid   - Global node id of the source node
+ *   count   - Number of changed edges
+ *   srcids  - Source node ids of the changed edges
+ *   dstids  - Destination node ids of the changed edges
+ *
+ * Removes every path from the source that uses a changed edge (its metrics
+ * are stale).  Paths the removed ones had dominated were thrown away, so the
+ * direct paths into the destinations that lost paths, or over a changed
+ * edge, are tried again, and the paths at every relay with an out-edge into
+ * such a destination, or with a changed out-edge, are marked as not
+ * expanded.  Running the
+ * source's engine afterwards extends them again and rebuilds the affected
+ * collections; the rest of the source's paths are left alone.  Sources
+ * that never reach a changed edge, or have no row yet, are skipped.
+ */
+void path_repair_source(pathopt_ctx *ctx, int srcid, int count, int *srcids, int *dstids) {
+  if (ctx->path_table[srcid] == NULL) return; // Nothing optimized from it yet
+  int reaches = false;
+  for(int i=0; i < count && !reaches; i++) {
+    reaches = (srcids[i] == srcid || path_collection_lookup(ctx, srcid, srcids[i])->count > 0);
+  }
+  if (!reaches) return;
+
+  char *affected = calloc(ctx->global_node_total, sizeof(char));
+  if (affected == NULL) {
+    printf("Memory Allocation failed: path_repair_source(%d)\n", ctx->global_node_total);
+    exit(1);
+  }
+
+  // Remove the paths that use a changed edge
+  for(int dstid=0; dstid < ctx->global_node_total; dstid++) {
+    if (srcid == dstid) continue;
+    path_collection_struct *collection = path_collection_lookup(ctx, srcid, dstid);
+    for(int j=0; j < collection->count; j++) {
+      for(int i=0; i < count; i++) {
+	if (!path_uses_edge(collection->paths[j], srcids[i], dstids[i])) continue;
+	front_remove(ctx, collection, j--);
+	affected[dstid] = true;
+	break;
+      }
+    }
+  }
+
+  // Try the direct paths into affected destinations again (duplicates are rejected)
+  for(int edge=ctx->adj_offsets[srcid]; edge < ctx->adj_offsets[srcid + 1]; edge++) {
+    int dstid = ctx->adj_targets[edge];
+    if (!affected[dstid]) {
+      for(int i=0; i < count && !affected[dstid]; i++) affected[dstid] = (srcids[i] == srcid && dstids[i] == dstid);
+      if (!affected[dstid]) continue;
+    }
+    path_struct *direct = create_path(ctx, srcid, dstid);
+    if (!add_path_attempt(ctx, path_collection_lookup(ctx, srcid, dstid), direct)) delete_path(ctx, direct);
+  }
+
+  // Extend the paths into the affected destinations and over the changed edges again
+  for(int relayid=0; relayid < ctx->global_node_total; relayid++) {
+    if (srcid == relayid) continue;
+    int redo = false;
+    for(int i=0; i < count && !redo; i++) redo = (srcids[i] == relayid);
+    for(int edge=ctx->adj_offsets[relayid]; edge < ctx->adj_offsets[relayid + 1] && !redo; edge++) {
+      redo = affected[ctx->adj_targets[edge]];
+    }
+    if (!redo) continue;
+    path_collection_struct *collection = path_collection_lookup(ctx, srcid, relayid);
+    for(int j=0; j < collection->count; j++) collection->paths[j]->expanded = false;
+    if (collection->count > 0) collection->dirty = true;
+  }
+
+  free(affected);
+}
+
+/*
+ * path_update_edges - Changes edge metrics and updates the optimized paths
+ *
+ * Arguments:
+ *   count    - Number of edges to update
+ *   srcnames - Source node name of each edge
+ *   dstnames - Destination node name of each edge
+ *   values   - count rows of global_metric_total new values, by metric
+ *              ordinal and as written in the input file (NAN leaves a
+ *              metric unchanged)
+ *   threads  - Number of worker threads for the re-optimization
+ *
+ * Updates the edges, then repairs the optimized paths with
+ * path_repair_edges, so only the paths that depend on the changed edges are
+ * recomputed.  The result is the same as
+ * optimizing the changed graph from scratch.  Every edge must already
+ * exist; if one does not, nothing is changed and ERROR is returned.
+ * Otherwise returns the number of edges whose metrics changed.
+ */
+int path_update_edges(pathopt_ctx *ctx, int count, char **srcnames, char **dstnames, double *values, int threads) {
+  int changed = 0;
+
+  // Check all the edges before changing any
+  for(int i=0; i < count; i++) {
+    int srcid = get_global_node_id(ctx, srcnames[i]);
+    int dstid = get_global_node_id(ctx, dstnames[i]);
+    if (srcid == ERROR || dstid == ERROR || get_global_edge(ctx, srcid, dstid) == NULL) {
+      fprintf(stderr, "Error: Unknown edge \"%s\" -> \"%s\"\n", srcnames[i], dstnames[i]);
+      return ERROR;
+    }
+  }
+
+  // Store the new metrics, keeping the edges that actually changed
+  int *srcids = malloc((count > 0 ? count : 1) * sizeof(int));
+  int *dstids = malloc((count > 0 ? count : 1) * sizeof(int));
+  if (srcids == NULL || dstids == NULL) {
+    printf("Memory Allocation failed: path_update_edges(%d)\n", count);
+    exit(1);
+  }
+  for(int i=0; i < count; i++) {
+    int srcid = get_global_node_id(ctx, srcnames[i]);
+    int dstid = get_global_node_id(ctx, dstnames[i]);
+    if (update_global_edge(ctx, srcid, dstid, values + i * ctx->global_metric_total) > 0) {
+      srcids[changed] = srcid;
+      dstids[changed] = dstid;
+      changed++;
+    }
+  }
+  if (changed > 0) path_repair_edges(ctx, changed, srcids, dstids, threads);
+
+  free(srcids);
+  free(dstids);
+  return changed;
+}
+
+/*
+ * path_repair_edges - Brings the optimized paths up to date after edge changes
+ *
+ * Arguments:
+ *   count   - Number of edges that were changed, added or removed
+ *   srcids  - Source node ids of the edges
+ *   dstids  - Destination node ids of the edges
+ *   threads - Number of worker threads for the re-optimization
+ *
+ * The edge hash table and the CSR index must already hold the new graph.
+ * Repairs every source with path_repair_source and resumes the optimization
+ * from the repaired table.  Does nothing before the path table exists.
+ */
+void path_repair_edges(pathopt_ctx *ctx, int count, int *srcids, int *dstids, int threads) {
+  if (ctx->path_table == NULL) return; // Nothing optimized yet
+
+  // A change can make a metric decide dominance again (or stop deciding it)
+  front_configure(ctx);
+
+  // Repair every source, then extend the paths that were reset
+  for(int srcid=0; srcid < ctx->global_node_total; srcid++) path_repair_source(ctx, srcid, count, srcids, dstids);
+  path_optimize_all(ctx, threads);
+}
+
+/*
+ * path_add_node - Adds a node to an optimized graph
+ *
+ * Arguments:
+ *   name        - Node name
+ *   description - Node description
+ *
+ * Adds the node and gives every source a collection for it (and the node a
+ * row and path pool of its own) without rebuilding the rest of the path
+ * table.  A new node has no edges, so no paths change until edges are
+ * added.  Before the path table exists only the node is added; the table is
+ * created at its full size when the graph is optimized or queried.  Returns
+ * the new node's id, or ERROR if the name is taken.
+ */
+int path_add_node(pathopt_ctx *ctx, char *name, char *description) {
+  if (get_global_node_id(ctx, name) != ERROR) {
+    fprintf(stderr, "Error: Node \"%s\" already exists\n", name);
+    return ERROR;
+  }
+  int previous = ctx->global_node_total;
+  add_global_node(ctx, name, description);
+  int nodeid = ctx->global_node_total - 1;
+
+  // Nothing optimized yet, so only the CSR offsets need the new node
+  if (ctx->path_table == NULL) {
+    build_global_adjacency(ctx);
+    return nodeid;
+  }
+
+  // Grow the pools, counters and rows by the new node
+  pool_struct *pools = realloc(ctx->path_pools, ctx->global_node_total * sizeof(pool_struct));
+  if (pools != NULL) ctx->path_pools = pools;
+  source_stats_struct *stats = realloc(ctx->source_stats, ctx->global_node_total * sizeof(source_stats_struct));
+  if (stats != NULL) ctx->source_stats = stats;
+  path_collection_struct **table = realloc(ctx->path_table, ctx->global_node_total * sizeof(path_collection_struct *));
+  if (table != NULL) ctx->path_table = table;
+  if (pools == NULL || stats == NULL || table == NULL) {
+    printf("Memory Allocation failed: path_add_node('%s')\n", name);
+    exit(1);
+  }
+  for(int id=previous; id < ctx->global_node_total; id++) {
+    pool_init(&ctx->path_pools[id], sizeof(path_struct) + ctx->global_metric_total * sizeof(double), POOL_BLOCK_OBJECTS);
+    memset(&ctx->source_stats[id], 0, sizeof(source_stats_struct));
+    ctx->path_table[id] = NULL;
+  }
+  for(int srcid=0; srcid < ctx->global_node_total; srcid++) {
+    if (ctx->path_table[srcid] == NULL && srcid != nodeid) continue; // Not set up yet (see path_query)
+    path_collection_struct *row = realloc(ctx->path_table[srcid], ctx->global_node_total * sizeof(path_collection_struct));
+    if (row == NULL) {
+      printf("Memory Allocation failed: path_add_node('%s')\n", name);
+      exit(1);
+    }
+    ctx->path_table[srcid] = row;
+    int first = (srcid == nodeid) ? (0) : (previous);
+    for(int dstid=first; dstid < ctx->global_node_total; dstid++) init_path_collection(&row[dstid], srcid, dstid);
+  }
+
+  // The CSR offsets need an entry for the new node
+  build_global_adjacency(ctx);
+  return nodeid;
+}
+
+/*
+ * path_remove_node - Removes a node from an optimized graph
+ *
+ * Arguments:
+ *   name    - Node name
+ *   threads - Number of worker threads for the re-optimization
+ *
+ * Releases the node's own paths, removes the node with its edges and then
+ * repairs the other sources as if those edges had changed, which purges
+ * every path through the node.  The node's id is left unused.  Returns
+ * ERROR if there is no such node.
+ */
+int path_remove_node(pathopt_ctx *ctx, char *name, int threads) {
+  int nodeid = get_global_node_id(ctx, name);
+  if (nodeid == ERROR) {
+    fprintf(stderr, "Error: Unknown node \"%s\"\n", name);
+    return ERROR;
+  }
+
+  // Collect the node's out-edges and in-edges before they are removed
+  int edges = ctx->adj_offsets[ctx->global_node_total];
+  int *srcids = malloc((edges > 0 ? edges : 1) * sizeof(int));
+  int *dstids = malloc((edges > 0 ? edges : 1) * sizeof(int));
+  if (srcids == NULL || dstids == NULL) {
+    printf("Memory Allocation failed: path_remove_node('%s')\n", name);
+    exit(1);
+  }
+  int count = 0;
+  for(int relayid=0; relayid < ctx->global_node_total; relayid++) {
+    for(int edge=ctx->adj_offsets[relayid]; edge < ctx->adj_offsets[relayid + 1]; edge++) {
+      if (relayid != nodeid && ctx->adj_targets[edge] != nodeid) continue;
+      srcids[count] = relayid;
+      dstids[count++] = ctx->adj_targets[edge];
+    }
+  }
+
+  if (ctx->path_table != NULL) release_source_paths(ctx, nodeid);
+  remove_global_node(ctx, nodeid);
+  build_global_adjacency(ctx);
+  if (count > 0) path_repair_edges(ctx, count, srcids, dstids, threads);
+
+  free(srcids);
+  free(dstids);
+  return 0;
+}
+
+/*
+ * path_add_edge - Adds an edge to an optimized graph
+ *
+ * Arguments:
+ *   srcname - Source node name
+ *   dstname - Destination node name
+ *   values  - Metric values by ordinal, as written in the input file (NAN
+ *             leaves a metric at the parser's default)
+ *   threads - Number of worker threads for the re-optimization
+ *
+ * Adds the edge and repairs the sources that reach its source node, so only
+ * expansions over the new edge (and what they improve) are run.  An edge
+ * that already exists gets its metrics updated with path_update_edges.
+ * Returns 1 if the graph changed, 0 if not or ERROR for an unknown node.
+ */
+int path_add_edge(pathopt_ctx *ctx, char *srcname, char *dstname, double *values, int threads) {
+  int srcid = get_global_node_id(ctx, srcname);
+  int dstid = get_global_node_id(ctx, dstname);
+  if (srcid == ERROR || dstid == ERROR) {
+    fprintf(stderr, "Error: Edge \"%s\" -> \"%s\" references an unknown node\n", srcname, dstname);
+    return ERROR;
+  }
+  if (get_global_edge(ctx, srcid, dstid) != NULL) return path_update_edges(ctx, 1, &srcname, &dstname, values, threads);
+
+  double *metrics = create_metrics(ctx);
+  for(int i=0; i < ctx->global_metric_total; i++) {
+    if (!isnan(values[i])) metrics[i] = values[i] * ctx->global_metric_table[i]->sign;
+  }
+  add_global_edge(ctx, srcname, dstname, metrics);
+  build_global_adjacency(ctx);
+  path_repair_edges(ctx, 1, &srcid, &dstid, threads);
+  return 1;
+}
+
+/*
+ * path_remove_edge - Removes an edge from an optimized graph
+ *
+ * Arguments:
+ *   srcname - Source node name
+ *   dstname - Destination node name
+ *   threads - Number of worker threads for the re-optimization
+ *
+ * Removes the edge and repairs the sources whose paths used it.  Returns
+ * ERROR if there is no such edge.
+ */
+int path_remove_edge(pathopt_ctx *ctx, char *srcname, char *dstname, int threads) {
+  int srcid = get_global_node_id(ctx, srcname);
+  int dstid = get_global_node_id(ctx, dstname);
+  if (srcid == ERROR || dstid == ERROR || remove_global_edge(ctx, srcid, dstid) == ERROR) {
+    fprintf(stderr, "Error: Unknown edge \"%s\" -> \"%s\"\n", srcname, dstname);
+    return ERROR;
+  }
+  build_global_adjacency(ctx);
+  path_repair_edges(ctx, 1, &srcid, &dstid, threads);
+  return 0;
+}
+
+/*
+ * path_collection_lookup - Lookup a path collection object
+ *
+ * Arguments:
+ *   srcid - Id of the source node
+ *   dstid - Id of the destination node
+ *
+ * Returns the path collection object that contains the list of
+ * non-dominated paths for that source/destination pair, straight
+ * from the path table.
+ */
+path_collection_struct *path_collection_lookup(pathopt_ctx *ctx, int srcid, int dstid) {
+  return &ctx->path_table[srcid][dstid];
+}
+
+/*
+ * path_front_export - Exposes one pair's Pareto front as flat arrays
+ *
+ * Arguments:
+ *   srcid - Source node id
+ *   dstid - Destination node id
+ *   front - Filled in with the front's arrays
+ *
+ * The metric rows are the collection's own contiguous rows (normalized, so
+ * OPT_MAX values are negated), in front order.  The node ids are rebuilt
+ * from the parent pointers into buffers owned by the context, one run per
+ * path with an offset index.  Nothing is copied to the caller: the arrays
+ * stay valid until the next export or the next change to the paths.
+ * Returns the number of paths, or ERROR for an unknown node or a source
+ * whose row was never set up.
+ */
+int path_front_export(pathopt_ctx *ctx, int srcid, int dstid, path_front_struct *front) {
+  if (srcid < 0 || srcid >= ctx->global_node_total || dstid < 0 || dstid >= ctx->global_node_total) return ERROR;
+  if (ctx->path_table == NULL || ctx->path_table[srcid] == NULL) return ERROR;
+  path_collection_struct *collection = path_collection_lookup(ctx, srcid, dstid);
+  int count = (srcid == dstid) ? (0) : (collection->count);
+
+  // Size the buffers for this front
+  int hops = 0;
+  for(int p=0; p < count; p++) hops += collection->paths[p]->length;
+  if (count + 1 > ctx->export_offsets_capacity) {
+    int *offsets = realloc(ctx->export_offsets, (count + 1) * sizeof(int));
+    if (offsets == NULL) {
+      printf("Memory Allocation failed: path_front_export(%d)\n", count);
+      exit(1);
+    }
+    ctx->export_offsets = offsets;
+    ctx->export_offsets_capacity = count + 1;
+  }
+  if (hops > ctx->export_nodes_capacity) {
+    int *nodes = realloc(ctx->export_nodes, hops * sizeof(int));
+    if (nodes == NULL) {
+      printf("Memory Allocation failed: path_front_export(%d)\n", hops);
+      exit(1);
+    }
+    ctx->export_nodes = nodes;
+    ctx->export_nodes_capacity = hops;
+  }
+
+  // Flatten the node sequences
+  ctx->export_offsets[0] = 0;
+  for(int p=0; p < count; p++) {
+    int length = path_nodes(collection->paths[p], ctx->export_nodes + ctx->export_offsets[p]);
+    ctx->export_offsets[p + 1] = ctx->export_offsets[p] + length;
+  }
+
+  front->count = count;
+  front->metric_count = ctx->global_metric_total;
+  front->values = collection->values;
+  front->offsets = ctx->export_offsets;
+  front->nodes = ctx->export_nodes;
+  return count;
+}
+
+/*
+ * write_pair_paths - Write the optimized paths of one pair to a file
+ *
+ * Arguments:
+ *   outfile - File descriptor (open file, stdout, stderr)
+ *   srcid   - Source node id
+ *   dstid   - Destination node id
+ *   nodes   - Buffer with room for global_node_total + 1 node ids
+ *
+ * Writes the pair's names, then one line per path with its metrics and
+ * node names, then a blank line.
+ */
+void write_pair_paths(pathopt_ctx *ctx, FILE *outfile, int srcid, int dstid, int *nodes) {
+  if (outfile == NULL) outfile = stdout;
+  // Display the node pair
+  fprintf(outfile, "%s|%s\n", get_global_node_name_by_index(ctx, srcid), get_global_node_name_by_index(ctx, dstid));
+  // Get the collection of pareto optimal routes
+  path_collection_struct *collection = path_collection_lookup(ctx, srcid, dstid);
+  for (int p=0; p < collection->count; p++) {
+    path_struct *path = collection->paths[p];
+    // Print out the metrics for the path
+    display_metrics(ctx, outfile, "", path->metrics, "|");
+    // print out the node list for the path
+    int length = path_nodes(path, nodes);
+    for(int i=0; i < length; i++) {
+      fprintf(outfile, "%s", get_global_node_name_by_index(ctx, nodes[i]));
+      if (i + 1 < length) fprintf(outfile, ",");
+    }
+    fprintf(outfile, "\n"); // End of the non-dominated path entry
+  }
+  fprintf(outfile, "\n"); // Divide the pairs
+}
+
 /*
  * write_optimized_paths - Write the optimized paths to a file
  *
@@ -461,38 +1316,57 @@ path_collection_struct *path_collection_lookup(char *srcname, char *dstname) {
  *   outfile - File descriptor (open file, stdout, stderr)
  *
  * Writes all the current optimized paths out to the FILE pointer
- * passed in.
+ * passed in.  Node ids are turned back into names here.  Sources without
+ * a row (never queried, see path_query) are left out.
  */
-void write_optimized_paths(FILE *outfile) {
-  // Create variables
-  path_collection_struct *collection = NULL;
+void write_optimized_paths(pathopt_ctx *ctx, FILE *outfile) {
+  double started = stats_clock();
+  // Buffer for rebuilding node sequences (a path never repeats a node)
+  int *nodes = malloc((ctx->global_node_total + 1) * sizeof(int));
+  if (nodes == NULL) {
+    printf("Memory Allocation failed: write_optimized_paths(%d)\n", ctx->global_node_total);
+    exit(1);
+  }
 
   // Loop through all source/destination pairs
-  for(global_node_struct *srcnode=global_nodes; srcnode != NULL; srcnode=srcnode->next) {
-    for(global_node_struct *dstnode=global_nodes; dstnode != NULL; dstnode=dstnode->next) {
-      if (srcnode == dstnode) continue;
-      // Display the node pair
-      if (outfile == NULL) printf("%s|%s\n", srcnode->name, dstnode->name);
-      else fprintf(outfile, "%s|%s\n", srcnode->name, dstnode->name);
-      // Get the collection of pareto optimal routes
-      collection = path_collection_lookup(srcnode->name, dstnode->name);
-      for (path_struct *path=collection->optlist;path!=NULL; path=path->next) {
-	// Print out the metrics for the path
-	display_metrics(outfile, "", path->metrics, "|");
-	// print out the node list for the path
-	for(node_struct *node=path->nodes;node!=NULL;node=node->next) {
-	  if (outfile == NULL) printf("%s", node->name);
-	  else fprintf(outfile, "%s", node->name);
-	  if (node->next != NULL) {
-	    if (outfile == NULL) printf(",");
-	    else fprintf(outfile, ",");
-	  }
-	}
-	if (outfile == NULL) printf("\n");
-	else fprintf(outfile, "\n"); // End of the non-dominated path entry
-      }
-      if (outfile == NULL) printf("\n");
-      else fprintf(outfile, "\n"); // Divide the pairs
+  for(global_node_struct *srcnode=ctx->global_nodes; srcnode != NULL; srcnode=srcnode->next) {
+    if (srcnode->removed || ctx->path_table[srcnode->id] == NULL) continue;
+    for(global_node_struct *dstnode=ctx->global_nodes; dstnode != NULL; dstnode=dstnode->next) {
+      if (srcnode == dstnode || dstnode->removed) continue;
+      write_pair_paths(ctx, outfile, srcnode->id, dstnode->id, nodes);
+    }
+  }
+  free(nodes);
+  ctx->phase_seconds[PHASE_WRITE] += stats_clock() - started;
+}
+
+/*
+ * write_query_paths - Write the result of a path_query to a file
+ *
+ * Arguments:
+ *   outfile - File descriptor (open file, stdout, stderr)
+ *   srcid   - Source node id returned by path_query
+ *   dstid   - Destination node id, or ERROR for every destination
+ *
+ * Same format as write_optimized_paths, for the queried pair or for every
+ * destination of the queried source.
+ */
+void write_query_paths(pathopt_ctx *ctx, FILE *outfile, int srcid, int dstid) {
+  double started = stats_clock();
+  int *nodes = malloc((ctx->global_node_total + 1) * sizeof(int));
+  if (nodes == NULL) {
+    printf("Memory Allocation failed: write_query_paths(%d)\n", ctx->global_node_total);
+    exit(1);
+  }
+
+  if (dstid != ERROR) {
+    if (dstid != srcid) write_pair_paths(ctx, outfile, srcid, dstid, nodes);
+  } else {
+    for(global_node_struct *dstnode=ctx->global_nodes; dstnode != NULL; dstnode=dstnode->next) {
+      if (dstnode->id == srcid || dstnode->removed) continue;
+      write_pair_paths(ctx, outfile, srcid, dstnode->id, nodes);
     }
   }
+  free(nodes);
+  ctx->phase_seconds[PHASE_WRITE] += stats_clock() - started;
 }
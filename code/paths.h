@@ -5,25 +5,56 @@
  * Path Object Functions *
  *************************/
 
-path_struct *create_path(char *srcname, char *dstname);
-path_struct *extend_path(path_struct *path, char *nodename);
-void delete_path(path_struct *path);
-void display_path(FILE *outfile, char *prefix, path_struct *path, char *postfix);
-int path_contains(path_struct *path, char *nodename);
+path_struct *create_path(pathopt_ctx *ctx, int srcid, int dstid);
+path_struct *extend_path(pathopt_ctx *ctx, path_struct *path, int nodeid, double *metrics);
+void delete_path(pathopt_ctx *ctx, path_struct *path);
+int path_nodes(path_struct *path, int *nodes);
+void display_path(pathopt_ctx *ctx, FILE *outfile, char *prefix, path_struct *path, char *postfix);
+int path_contains(pathopt_ctx *ctx, path_struct *path, int nodeid);
+int path_uses_edge(path_struct *path, int srcid, int dstid);
 
 /********************
  * Path Comparisons *
  ********************/
 
-path_collection_struct *new_path_collection(char *srcname, char *dstname);
-void init_global_path_table();
-int dominates_path(path_struct *path, path_struct *other);
+void init_path_collection(path_collection_struct *collection, int srcid, int dstid);
+void init_global_path_table(pathopt_ctx *ctx);
+void init_path_table(pathopt_ctx *ctx);
+void init_source_paths(pathopt_ctx *ctx, int srcid);
+void release_source_paths(pathopt_ctx *ctx, int srcid);
+void free_global_path_table(pathopt_ctx *ctx);
+void path_pool_stats(pathopt_ctx *ctx, unsigned long *allocations, size_t *peak_bytes);
+int dominates_path(pathopt_ctx *ctx, path_struct *path, path_struct *other);
 int duplicate_path(path_struct *first, path_struct *second);
-int clear_dominated_paths(path_collection_struct *collection);
-int add_path_attempt(path_collection_struct *collection, path_struct *path);
-void path_optimize_source(char *srcname);
-void path_optimize_source_id(int);
-path_collection_struct *path_collection_lookup(char *srcname, char *dstname);
-void write_optimized_paths(FILE *outfile);
+int compare_paths_lex(pathopt_ctx *ctx, path_struct *first, path_struct *second);
+int clear_dominated_paths(pathopt_ctx *ctx, path_collection_struct *collection);
+int add_path_attempt(pathopt_ctx *ctx, path_collection_struct *collection, path_struct *path);
+void path_optimize_source(pathopt_ctx *ctx, char *srcname);
+int path_optimize_source_id(pathopt_ctx *ctx, int srcid);
+int path_optimize_source_rounds(pathopt_ctx *ctx, int srcid);
+int path_optimize_source_label(pathopt_ctx *ctx, int srcid);
+int path_optimize_source_bounded(pathopt_ctx *ctx, int srcid, int dstid);
+void *path_optimize_worker(void *arg);
+void path_optimize_reset(pathopt_ctx *ctx, int running);
+void path_optimize_run(pathopt_ctx *ctx, int threads);
+void path_optimize_all(pathopt_ctx *ctx, int threads);
+void *path_optimize_thread(void *arg);
+int path_optimize_start(pathopt_ctx *ctx, int threads);
+void path_optimize_progress(pathopt_ctx *ctx, optimize_progress_struct *progress);
+void path_optimize_cancel(pathopt_ctx *ctx);
+int path_optimize_wait(pathopt_ctx *ctx);
+int path_query(pathopt_ctx *ctx, char *srcname, char *dstname);
+void path_repair_source(pathopt_ctx *ctx, int srcid, int count, int *srcids, int *dstids);
+int path_update_edges(pathopt_ctx *ctx, int count, char **srcnames, char **dstnames, double *values, int threads);
+void path_repair_edges(pathopt_ctx *ctx, int count, int *srcids, int *dstids, int threads);
+int path_add_node(pathopt_ctx *ctx, char *name, char *description);
+int path_remove_node(pathopt_ctx *ctx, char *name, int threads);
+int path_add_edge(pathopt_ctx *ctx, char *srcname, char *dstname, double *values, int threads);
+int path_remove_edge(pathopt_ctx *ctx, char *srcname, char *dstname, int threads);
+path_collection_struct *path_collection_lookup(pathopt_ctx *ctx, int srcid, int dstid);
+int path_front_export(pathopt_ctx *ctx, int srcid, int dstid, path_front_struct *front);
+void write_pair_paths(pathopt_ctx *ctx, FILE *outfile, int srcid, int dstid, int *nodes);
+void write_optimized_paths(pathopt_ctx *ctx, FILE *outfile);
+void write_query_paths(pathopt_ctx *ctx, FILE *outfile, int srcid, int dstid);
 
 #endif
@@ -0,0 +1,115 @@
+#include <stdlib.h> // malloc, free
+#include <stdio.h>  // printf
+
+#include "global.h"
+#include "pool.h"
+
+/*************************
+ * Object Pool Functions *
+ *************************/
+
+/*
+ * pool_init - Initializes an empty object pool
+ *
+ * Arguments:
+ *   pool          - Pool to initialize
+ *   object_size   - Size of every object handed out by the pool
+ *   block_objects - Number of objects carved out of each block
+ *
+ * Objects are rounded up to the alignment of a double (or a pointer, which
+ * the free list stores in released objects).  No memory is allocated until
+ * the first pool_alloc.
+ */
+void pool_init(pool_struct *pool, size_t object_size, size_t block_objects) {
+  size_t align = (sizeof(double) > sizeof(void *)) ? (sizeof(double)) : (sizeof(void *));
+  if (object_size < sizeof(void *)) object_size = sizeof(void *);
+  pool->object_size = (object_size + align - 1) / align * align;
+  pool->block_objects = (block_objects > 0) ? (block_objects) : (1);
+  pool->blocks = NULL;
+  pool->cursor = NULL;
+  pool->limit = NULL;
+  pool->free_list = NULL;
+  pool->allocations = 0;
+  pool->live = 0;
+  pool->bytes = 0;
+  pool->peak_bytes = 0;
+}
+
+/*
+ * pool_alloc - Hands out one object from the pool
+ *
+ * Arguments:
+ *   pool - Pool to allocate from
+ *
+ * Reuses a released object when there is one, otherwise takes the next
+ * object from the current block, allocating a new block when it is used up.
+ */
+void *pool_alloc(pool_struct *pool) {
+  void *object;
+
+  if (pool->free_list != NULL) {
+    // Reuse a released object
+    object = pool->free_list;
+    pool->free_list = *(void **)object;
+  } else {
+    if (pool->cursor == pool->limit) {
+      // Start a new block
+      size_t size = sizeof(pool_block_struct) + pool->object_size * pool->block_objects;
+      pool_block_struct *block = malloc(size);
+      if (block == NULL) {
+	printf("Memory Allocation failed: pool_alloc(%zu bytes)\n", size);
+	exit(1);
+      }
+      block->next = pool->blocks;
+      pool->blocks = block;
+      pool->cursor = (char *)block->data;
+      pool->limit = (char *)block->data + pool->object_size * pool->block_objects;
+      pool->bytes += size;
+      if (pool->bytes > pool->peak_bytes) pool->peak_bytes = pool->bytes;
+    }
+    object = pool->cursor;
+    pool->cursor += pool->object_size;
+  }
+
+  pool->allocations++;
+  pool->live++;
+  return object;
+}
+
+/*
+ * pool_free - Returns one object to the pool
+ *
+ * Arguments:
+ *   pool   - Pool the object came from
+ *   object - Object to release
+ *
+ * Puts the object on the free list so the next pool_alloc can reuse it.
+ */
+void pool_free(pool_struct *pool, void *object) {
+  *(void **)object = pool->free_list;
+  pool->free_list = object;
+  pool->live--;
+}
+
+/*
+ * pool_release - Frees every block of the pool at once
+ *
+ * Arguments:
+ *   pool - Pool to release
+ *
+ * All objects handed out by the pool become invalid.  The pool is left
+ * empty and ready for reuse; the allocation count and peak are kept.
+ */
+void pool_release(pool_struct *pool) {
+  pool_block_struct *temp;
+  while(pool->blocks != NULL) {
+    temp = pool->blocks;
+    pool->blocks = temp->next;
+    free(temp);
+  }
+  pool->cursor = NULL;
+  pool->limit = NULL;
+  pool->free_list = NULL;
+  pool->live = 0;
+  pool->bytes = 0;
+}
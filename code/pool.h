@@ -0,0 +1,13 @@
+#ifndef POOL_H
+#define POOL_H
+
+/*************************
+ * Object Pool Functions *
+ *************************/
+
+void pool_init(pool_struct *pool, size_t object_size, size_t block_objects);
+void *pool_alloc(pool_struct *pool);
+void pool_free(pool_struct *pool, void *object);
+void pool_release(pool_struct *pool);
+
+#endif
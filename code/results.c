@@ -0,0 +1,364 @@
+#include <string.h>     // memcpy, strnlen
+#include <stdlib.h>     // malloc, free
+#include <stdio.h>      // printf, fopen, fwrite
+#include <stdbool.h>    // true, false
+#include <fcntl.h>      // open
+#include <unistd.h>     // close
+#include <sys/mman.h>   // mmap, munmap
+#include <sys/stat.h>   // fstat
+
+#include "global.h"
+#include "graph.h"
+#include "paths.h"
+#include "snapshot.h"
+#include "results.h"
+#include "stats.h"
+
+/************************
+ * Binary Result Writer *
+ ************************/
+
+/*
+ * results_write - Adds bytes to a result file through the writer's buffer
+ *
+ * Arguments:
+ *   writer - Buffered writer
+ *   data   - Bytes to write
+ *   bytes  - Number of bytes
+ *
+ * Small writes are collected in the buffer and written with one fwrite
+ * when it fills up.
+ */
+void results_write(results_writer_struct *writer, const void *data, size_t bytes) {
+  writer->written += bytes;
+  if (writer->used + bytes > RESULTS_BUFFER_BYTES) {
+    results_flush(writer);
+    if (bytes > RESULTS_BUFFER_BYTES) {
+      if (fwrite(data, 1, bytes, writer->file) != bytes) writer->failed = true;
+      return;
+    }
+  }
+  memcpy(writer->buffer + writer->used, data, bytes);
+  writer->used += bytes;
+}
+
+/*
+ * results_flush - Writes out the writer's buffer
+ *
+ * Arguments:
+ *   writer - Buffered writer
+ */
+void results_flush(results_writer_struct *writer) {
+  if (writer->used > 0 && fwrite(writer->buffer, 1, writer->used, writer->file) != writer->used) writer->failed = true;
+  writer->used = 0;
+}
+
+/*
+ * results_pad - Pads a result file to the next multiple of 8 bytes
+ *
+ * Arguments:
+ *   writer - Buffered writer
+ */
+void results_pad(results_writer_struct *writer) {
+  static const char zeros[8] = {0};
+  results_write(writer, zeros, snapshot_align(writer->written) - writer->written);
+}
+
+/*
+ * results_collection - Collection of a pair as it is written to a result file
+ *
+ * Arguments:
+ *   srcid - Source node id
+ *   dstid - Destination node id
+ *
+ * Returns NULL for the pairs that are written without paths: a node to
+ * itself, pairs with a removed node and sources that were never set up.
+ */
+path_collection_struct *results_collection(pathopt_ctx *ctx, int srcid, int dstid) {
+  if (srcid == dstid || ctx->global_node_table[srcid]->removed || ctx->global_node_table[dstid]->removed) return NULL;
+  if (ctx->path_table[srcid] == NULL) return NULL;
+  return path_collection_lookup(ctx, srcid, dstid);
+}
+
+/*
+ * write_optimized_paths_binary - Writes the optimized paths in the binary result format
+ *
+ * Arguments:
+ *   filename - Result file to create
+ *
+ * The binary counterpart of write_optimized_paths.  Pairs are stored by
+ * node id with an offset index, each path as an array of node ids and the
+ * metrics as one full precision column per metric (see
+ * results_header_struct).  The sizes are counted first so the header can
+ * be written up front, then every section is streamed out through a large
+ * buffer.  Returns ERROR if the file cannot be written.
+ */
+int write_optimized_paths_binary(pathopt_ctx *ctx, char *filename) {
+  double started = stats_clock();
+  results_header_struct header;
+  uint64_t n = ctx->global_node_total;
+  int k = ctx->global_metric_total;
+
+  // Count the paths, their nodes and the names
+  uint64_t names_size = 0;
+  memset(&header, 0, sizeof(header));
+  for(int i=0; i < k; i++) names_size += strnlen(ctx->global_metric_table[i]->name, NAME_MAX_LENGTH) + 1;
+  for(uint64_t srcid=0; srcid < n; srcid++) {
+    names_size += strnlen(ctx->global_node_table[srcid]->name, NAME_MAX_LENGTH) + 1;
+    for(uint64_t dstid=0; dstid < n; dstid++) {
+      path_collection_struct *collection = results_collection(ctx, srcid, dstid);
+      if (collection == NULL) continue;
+      header.path_count += collection->count;
+      for(int p=0; p < collection->count; p++) header.hop_count += collection->paths[p]->length;
+    }
+  }
+
+  // Lay out the sections
+  memcpy(header.magic, RESULTS_MAGIC, 8);
+  header.version = RESULTS_VERSION;
+  header.byte_order = SNAPSHOT_BYTE_ORDER;
+  header.metric_count = k;
+  header.node_count = n;
+  header.names_offset = snapshot_align(sizeof(header));
+  header.name_index_offset = snapshot_align(header.names_offset + names_size);
+  header.pairs_offset = snapshot_align(header.name_index_offset + (k + n) * sizeof(uint32_t));
+  header.paths_offset = header.pairs_offset + (n * n + 1) * sizeof(uint64_t);
+  header.nodes_offset = header.paths_offset + (header.path_count + 1) * sizeof(uint64_t);
+  header.values_offset = snapshot_align(header.nodes_offset + header.hop_count * sizeof(int));
+  header.file_size = header.values_offset + header.path_count * k * sizeof(double);
+
+  results_writer_struct writer;
+  writer.file = fopen(filename, "wb");
+  writer.buffer = malloc(RESULTS_BUFFER_BYTES);
+  writer.used = 0;
+  writer.written = 0;
+  writer.failed = false;
+  // Buffer for rebuilding node sequences (a path never repeats a node)
+  int *nodes = malloc((n + 1) * sizeof(int));
+  if (writer.file == NULL || writer.buffer == NULL || nodes == NULL) {
+    printf("Error: Could not write results \"%s\"\n", filename);
+    if (writer.file != NULL) fclose(writer.file);
+    free(writer.buffer);
+    free(nodes);
+    return ERROR;
+  }
+  results_write(&writer, &header, sizeof(header));
+
+  // Names and their offsets
+  results_pad(&writer);
+  for(int i=0; i < k; i++) results_write(&writer, ctx->global_metric_table[i]->name, strnlen(ctx->global_metric_table[i]->name, NAME_MAX_LENGTH) + 1);
+  for(uint64_t i=0; i < n; i++) results_write(&writer, ctx->global_node_table[i]->name, strnlen(ctx->global_node_table[i]->name, NAME_MAX_LENGTH) + 1);
+  results_pad(&writer);
+  uint32_t offset = 0;
+  for(int i=0; i < k; i++) {
+    results_write(&writer, &offset, sizeof(offset));
+    offset += strnlen(ctx->global_metric_table[i]->name, NAME_MAX_LENGTH) + 1;
+  }
+  for(uint64_t i=0; i < n; i++) {
+    results_write(&writer, &offset, sizeof(offset));
+    offset += strnlen(ctx->global_node_table[i]->name, NAME_MAX_LENGTH) + 1;
+  }
+  results_pad(&writer);
+
+  // Pair index (every pair, so a pair's paths are found by its node ids)
+  uint64_t index = 0;
+  for(uint64_t srcid=0; srcid < n; srcid++) {
+    for(uint64_t dstid=0; dstid < n; dstid++) {
+      results_write(&writer, &index, sizeof(index));
+      path_collection_struct *collection = results_collection(ctx, srcid, dstid);
+      if (collection != NULL) index += collection->count;
+    }
+  }
+  results_write(&writer, &index, sizeof(index));
+
+  // Path index, then the node ids of each path
+  index = 0;
+  for(uint64_t srcid=0; srcid < n; srcid++) {
+    for(uint64_t dstid=0; dstid < n; dstid++) {
+      path_collection_struct *collection = results_collection(ctx, srcid, dstid);
+      if (collection == NULL) continue;
+      for(int p=0; p < collection->count; p++) {
+	results_write(&writer, &index, sizeof(index));
+	index += collection->paths[p]->length;
+      }
+    }
+  }
+  results_write(&writer, &index, sizeof(index));
+  for(uint64_t srcid=0; srcid < n; srcid++) {
+    for(uint64_t dstid=0; dstid < n; dstid++) {
+      path_collection_struct *collection = results_collection(ctx, srcid, dstid);
+      if (collection == NULL) continue;
+      for(int p=0; p < collection->count; p++) {
+	int length = path_nodes(collection->paths[p], nodes);
+	results_write(&writer, nodes, length * sizeof(int));
+      }
+    }
+  }
+  results_pad(&writer);
+
+  // One column per metric, from the fronts' contiguous metric rows
+  for(int i=0; i < k; i++) {
+    double sign = ctx->global_metric_table[i]->sign;
+    for(uint64_t srcid=0; srcid < n; srcid++) {
+      for(uint64_t dstid=0; dstid < n; dstid++) {
+	path_collection_struct *collection = results_collection(ctx, srcid, dstid);
+	if (collection == NULL) continue;
+	for(int p=0; p < collection->count; p++) {
+	  double value = collection->values[p * k + i] * sign;
+	  results_write(&writer, &value, sizeof(value));
+	}
+      }
+    }
+  }
+
+  results_flush(&writer);
+  if (fclose(writer.file) != 0 || writer.written != header.file_size) writer.failed = true;
+  free(writer.buffer);
+  free(nodes);
+  ctx->phase_seconds[PHASE_WRITE] += stats_clock() - started;
+  if (writer.failed) {
+    printf("Error: Could not write results \"%s\"\n", filename);
+    return ERROR;
+  }
+  return 0;
+}
+
+/************************
+ * Binary Result Reader *
+ ************************/
+
+/*
+ * results_open - Opens a binary result file for reading
+ *
+ * Arguments:
+ *   results  - Reader to set up
+ *   filename - File written by write_optimized_paths_binary
+ *
+ * Maps the file read only and points the reader's arrays into it after
+ * checking the header and the section bounds.  Returns ERROR (after
+ * printing why) if the file cannot be used.
+ */
+int results_open(results_struct *results, char *filename) {
+  memset(results, 0, sizeof(results_struct));
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    printf("Error: Could not open results \"%s\"\n", filename);
+    return ERROR;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(results_header_struct)) {
+    close(fd);
+    printf("Error: \"%s\" is not a result file\n", filename);
+    return ERROR;
+  }
+  size_t size = info.st_size;
+  char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return ERROR;
+
+  results_header_struct *header = (results_header_struct *)data;
+  uint64_t n = header->node_count, k = header->metric_count;
+  char *problem = NULL;
+  if (memcmp(header->magic, RESULTS_MAGIC, 8) != 0) problem = "not a result file";
+  else if (header->version != RESULTS_VERSION) problem = "unsupported version";
+  else if (header->byte_order != SNAPSHOT_BYTE_ORDER) problem = "written on a machine with a different byte order";
+  else if (header->file_size != size) problem = "truncated";
+  else if (header->name_index_offset + (k + n) * sizeof(uint32_t) > header->pairs_offset ||
+	   header->pairs_offset + (n * n + 1) * sizeof(uint64_t) > header->paths_offset ||
+	   header->paths_offset + (header->path_count + 1) * sizeof(uint64_t) > header->nodes_offset ||
+	   header->nodes_offset + header->hop_count * sizeof(int) > header->values_offset ||
+	   header->values_offset + header->path_count * k * sizeof(double) > size) problem = "sections out of bounds";
+  if (problem != NULL) {
+    printf("Error: Results \"%s\": %s\n", filename, problem);
+    munmap(data, size);
+    return ERROR;
+  }
+
+  results->data = data;
+  results->size = size;
+  results->header = header;
+  results->name_index = (uint32_t *)(data + header->name_index_offset);
+  results->pairs = (uint64_t *)(data + header->pairs_offset);
+  results->paths = (uint64_t *)(data + header->paths_offset);
+  results->nodes = (int *)(data + header->nodes_offset);
+  results->values = (double *)(data + header->values_offset);
+  return 0;
+}
+
+/*
+ * results_close - Unmaps a result file opened with results_open
+ *
+ * Arguments:
+ *   results - Reader to close
+ */
+void results_close(results_struct *results) {
+  if (results->data != NULL) munmap(results->data, results->size);
+  memset(results, 0, sizeof(results_struct));
+}
+
+/*
+ * results_metric_name - Name of a metric column
+ *
+ * Arguments:
+ *   results - Open reader
+ *   metric  - Metric ordinal
+ */
+char *results_metric_name(results_struct *results, int metric) {
+  return results->data + results->header->names_offset + results->name_index[metric];
+}
+
+/*
+ * results_node_name - Name of a node id
+ *
+ * Arguments:
+ *   results - Open reader
+ *   nodeid  - Node id
+ */
+char *results_node_name(results_struct *results, int nodeid) {
+  return results->data + results->header->names_offset + results->name_index[results->header->metric_count + nodeid];
+}
+
+/*
+ * results_pair - Finds the paths of a source/destination pair
+ *
+ * Arguments:
+ *   results - Open reader
+ *   srcid   - Source node id
+ *   dstid   - Destination node id
+ *   first   - Set to the index of the pair's first path
+ *
+ * Returns the number of paths for the pair (its paths are first to first
+ * plus the count minus one).
+ */
+int results_pair(results_struct *results, int srcid, int dstid, uint64_t *first) {
+  uint64_t pair = (uint64_t)srcid * results->header->node_count + dstid;
+  *first = results->pairs[pair];
+  return results->pairs[pair + 1] - results->pairs[pair];
+}
+
+/*
+ * results_path_nodes - Node ids of a path
+ *
+ * Arguments:
+ *   results - Open reader
+ *   path    - Path index
+ *   nodes   - Set to the path's node ids (in the mapped file)
+ *
+ * Returns the number of nodes in the path.
+ */
+int results_path_nodes(results_struct *results, uint64_t path, const int **nodes) {
+  *nodes = results->nodes + results->paths[path];
+  return results->paths[path + 1] - results->paths[path];
+}
+
+/*
+ * results_value - Metric value of a path
+ *
+ * Arguments:
+ *   results - Open reader
+ *   metric  - Metric ordinal
+ *   path    - Path index
+ */
+double results_value(results_struct *results, int metric, uint64_t path) {
+  return results->values[(uint64_t)metric * results->header->path_count + path];
+}
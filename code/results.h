@@ -0,0 +1,26 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+
+/************************
+ * Binary Result Writer *
+ ************************/
+
+void results_write(results_writer_struct *writer, const void *data, size_t bytes);
+void results_flush(results_writer_struct *writer);
+void results_pad(results_writer_struct *writer);
+path_collection_struct *results_collection(pathopt_ctx *ctx, int srcid, int dstid);
+int write_optimized_paths_binary(pathopt_ctx *ctx, char *filename);
+
+/************************
+ * Binary Result Reader *
+ ************************/
+
+int results_open(results_struct *results, char *filename);
+void results_close(results_struct *results);
+char *results_metric_name(results_struct *results, int metric);
+char *results_node_name(results_struct *results, int nodeid);
+int results_pair(results_struct *results, int srcid, int dstid, uint64_t *first);
+int results_path_nodes(results_struct *results, uint64_t path, const int **nodes);
+double results_value(results_struct *results, int metric, uint64_t path);
+
+#endif
@@ -0,0 +1,315 @@
+#include <string.h>     // memcmp, memcpy, memchr, strnlen
+#include <stdlib.h>     // malloc, free
+#include <stdio.h>      // printf, fopen, fwrite
+#include <stdbool.h>    // true, false
+#include <limits.h>     // INT_MAX
+#include <fcntl.h>      // open
+#include <unistd.h>     // close
+#include <sys/mman.h>   // mmap, munmap
+#include <sys/stat.h>   // fstat
+
+#include "global.h"
+#include "metrics.h"
+#include "graph.h"
+#include "snapshot.h"
+
+/*************************************
+ * Compiled Graph Snapshot Functions *
+ *************************************/
+
+/*
+ * snapshot_checksum - Checksums a block of memory
+ *
+ * Arguments:
+ *   data - Start of the block (8 byte aligned)
+ *   size - Bytes in the block (a multiple of 8)
+ *
+ * A 64-bit FNV-1a style hash taken a word at a time, so checking a large
+ * snapshot costs about as much as reading it.
+ */
+uint64_t snapshot_checksum(const void *data, size_t size) {
+  const uint64_t *words = data;
+  uint64_t hash = 14695981039346656037ULL;
+  for(size_t i=0; i < size / sizeof(uint64_t); i++) {
+    hash ^= words[i];
+    hash *= 1099511628211ULL;
+    hash ^= hash >> 29;
+  }
+  return hash;
+}
+
+/*
+ * snapshot_align - Rounds a file offset up to the next multiple of 8
+ *
+ * Arguments:
+ *   offset - File offset
+ */
+uint64_t snapshot_align(uint64_t offset) {
+  return (offset + 7) & ~(uint64_t)7;
+}
+
+/*
+ * snapshot_owns - Checks if memory belongs to the loaded snapshot
+ *
+ * Arguments:
+ *   pointer - Pointer to check
+ *
+ * Arrays and metric vectors that point into the mapped snapshot must not
+ * be freed.  Returns true if the pointer is inside it.
+ */
+int snapshot_owns(pathopt_ctx *ctx, const void *pointer) {
+  const char *address = pointer;
+  return ctx->snapshot_data != NULL && address >= ctx->snapshot_data && address < ctx->snapshot_data + ctx->snapshot_size;
+}
+
+/*
+ * snapshot_name - Finds a name in the names section of a snapshot
+ *
+ * Arguments:
+ *   names  - Start of the names section
+ *   size   - Bytes in the names section
+ *   offset - Offset of the name, as stored in a metric or node record
+ *
+ * Returns the name, or NULL if the offset is outside the section or the
+ * name is not terminated inside it.
+ */
+char *snapshot_name(char *names, uint64_t size, uint32_t offset) {
+  if (offset >= size || memchr(names + offset, '\0', size - offset) == NULL) return NULL;
+  return names + offset;
+}
+
+/*
+ * is_snapshot - Checks if a file is a compiled graph snapshot
+ *
+ * Arguments:
+ *   filename - File to check
+ *
+ * Returns true if the file starts with SNAPSHOT_MAGIC.
+ */
+int is_snapshot(char *filename) {
+  char magic[8];
+  FILE *file = fopen(filename, "rb");
+  if (file == NULL) return false;
+  int found = (fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, SNAPSHOT_MAGIC, 8) == 0);
+  fclose(file);
+  return found;
+}
+
+/*
+ * write_snapshot - Writes the parsed graph to a compiled snapshot file
+ *
+ * Arguments:
+ *   filename - Snapshot file to create
+ *
+ * Lays out the header, the interned names (metric names, then node names
+ * and descriptions), the metric and node records and the CSR arrays with
+ * their normalized metric rows, each section 8 byte aligned.  The file is
+ * built in memory so the checksum can be filled in, then written with one
+ * fwrite.  Call after parse_file.  Returns ERROR if the file cannot be
+ * written.
+ */
+int write_snapshot(pathopt_ctx *ctx, char *filename) {
+  snapshot_header_struct header;
+  int nodes = ctx->global_node_total;
+  int edges = (ctx->adj_offsets != NULL) ? (ctx->adj_offsets[nodes]) : (0);
+  int k = ctx->global_metric_total;
+
+  // Size the names section
+  uint64_t names_size = 0;
+  for(int i=0; i < k; i++) names_size += strnlen(ctx->global_metric_table[i]->name, NAME_MAX_LENGTH) + 1;
+  for(int i=0; i < nodes; i++) {
+    names_size += strnlen(ctx->global_node_table[i]->name, NAME_MAX_LENGTH) + 1;
+    names_size += strnlen(ctx->global_node_table[i]->description, NAME_MAX_LENGTH) + 1;
+  }
+
+  // Lay out the sections
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, 8);
+  header.version = SNAPSHOT_VERSION;
+  header.byte_order = SNAPSHOT_BYTE_ORDER;
+  header.metric_count = k;
+  header.node_count = nodes;
+  header.edge_count = edges;
+  header.names_offset = snapshot_align(sizeof(header));
+  header.metrics_offset = snapshot_align(header.names_offset + names_size);
+  header.nodes_offset = snapshot_align(header.metrics_offset + k * sizeof(snapshot_metric_struct));
+  header.offsets_offset = snapshot_align(header.nodes_offset + nodes * sizeof(snapshot_node_struct));
+  header.targets_offset = snapshot_align(header.offsets_offset + (nodes + 1) * sizeof(int));
+  header.values_offset = snapshot_align(header.targets_offset + edges * sizeof(int));
+  header.file_size = snapshot_align(header.values_offset + (uint64_t)edges * k * sizeof(double));
+
+  char *data = calloc(header.file_size, 1);
+  if (data == NULL) {
+    printf("Memory Allocation failed: write_snapshot(%llu)\n", (unsigned long long)header.file_size);
+    exit(1);
+  }
+
+  // Intern the names and fill in the records
+  char *names = data + header.names_offset;
+  uint32_t used = 0;
+  snapshot_metric_struct *metric_records = (snapshot_metric_struct *)(data + header.metrics_offset);
+  for(int i=0; i < k; i++) {
+    global_metric_struct *gms = ctx->global_metric_table[i];
+    size_t length = strnlen(gms->name, NAME_MAX_LENGTH);
+    metric_records[i].name = used;
+    metric_records[i].opt = gms->opt;
+    metric_records[i].combo = gms->combo;
+    metric_records[i].arg = gms->arg;
+    memcpy(names + used, gms->name, length);
+    used += length + 1;
+  }
+  snapshot_node_struct *node_records = (snapshot_node_struct *)(data + header.nodes_offset);
+  for(int i=0; i < nodes; i++) {
+    size_t length = strnlen(ctx->global_node_table[i]->name, NAME_MAX_LENGTH);
+    node_records[i].name = used;
+    memcpy(names + used, ctx->global_node_table[i]->name, length);
+    used += length + 1;
+    length = strnlen(ctx->global_node_table[i]->description, NAME_MAX_LENGTH);
+    node_records[i].description = used;
+    memcpy(names + used, ctx->global_node_table[i]->description, length);
+    used += length + 1;
+  }
+
+  // The CSR arrays as they are in memory
+  if (ctx->adj_offsets != NULL) {
+    memcpy(data + header.offsets_offset, ctx->adj_offsets, (nodes + 1) * sizeof(int));
+    memcpy(data + header.targets_offset, ctx->adj_targets, edges * sizeof(int));
+    memcpy(data + header.values_offset, ctx->adj_metrics, (size_t)edges * k * sizeof(double));
+  }
+
+  header.checksum = snapshot_checksum(data + sizeof(header), header.file_size - sizeof(header));
+  memcpy(data, &header, sizeof(header));
+
+  FILE *file = fopen(filename, "wb");
+  int status = (file != NULL && fwrite(data, 1, header.file_size, file) == header.file_size) ? (0) : (ERROR);
+  if (file != NULL && fclose(file) != 0) status = ERROR;
+  free(data);
+  if (status == ERROR) printf("Error: Could not write snapshot \"%s\"\n", filename);
+  return status;
+}
+
+/*
+ * load_snapshot - Loads a compiled graph snapshot
+ *
+ * Arguments:
+ *   filename - Snapshot file written by write_snapshot
+ *
+ * Maps the file (privately, so later edge updates stay in memory), checks
+ * the version, byte order, section bounds, checksum, CSR index and names
+ * (the checksum only catches damage, not a crafted file), and then uses it
+ * in place: the CSR index points straight into the mapping and each edge
+ * in the edge hash points at its row there, so nothing is allocated per
+ * edge.  Metrics and nodes are added through the usual functions, in the
+ * same order as the original file, so node ids and output order match a
+ * text parse.  The graph must be empty.  Returns ERROR (after printing why)
+ * if the snapshot cannot be used.
+ */
+int load_snapshot(pathopt_ctx *ctx, char *filename) {
+  if (ctx->global_metric_total != 0 || ctx->global_node_total != 0 || ctx->snapshot_data != NULL) {
+    printf("Error: A snapshot can only be loaded into an empty graph\n");
+    return ERROR;
+  }
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) return ERROR;
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(snapshot_header_struct)) {
+    close(fd);
+    printf("Error: \"%s\" is not a snapshot\n", filename);
+    return ERROR;
+  }
+  size_t size = info.st_size;
+  char *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return ERROR;
+
+  // Check the header before trusting any offset in it
+  snapshot_header_struct *header = (snapshot_header_struct *)data;
+  uint64_t nodes = header->node_count, edges = header->edge_count, k = header->metric_count;
+  char *problem = NULL;
+  if (memcmp(header->magic, SNAPSHOT_MAGIC, 8) != 0) problem = "not a snapshot";
+  else if (header->version != SNAPSHOT_VERSION) problem = "unsupported version";
+  else if (header->byte_order != SNAPSHOT_BYTE_ORDER) problem = "written on a machine with a different byte order";
+  else if (header->file_size != size || size % 8 != 0) problem = "truncated";
+  else if (nodes > INT_MAX || edges > INT_MAX) problem = "too large";
+  // Offsets past the end, or an edge value count that overflows, would wrap the sums below
+  else if (header->names_offset > size || header->metrics_offset > size || header->nodes_offset > size ||
+	   header->offsets_offset > size || header->targets_offset > size || header->values_offset > size ||
+	   (edges > 0 && k > size / sizeof(double) / edges)) problem = "sections out of bounds";
+  else if (header->names_offset > header->metrics_offset ||
+	   header->metrics_offset + k * sizeof(snapshot_metric_struct) > header->nodes_offset ||
+	   header->nodes_offset + nodes * sizeof(snapshot_node_struct) > header->offsets_offset ||
+	   header->offsets_offset + (nodes + 1) * sizeof(int) > header->targets_offset ||
+	   header->targets_offset + edges * sizeof(int) > header->values_offset ||
+	   header->values_offset + edges * k * sizeof(double) > size ||
+	   header->values_offset % 8 != 0 || header->metrics_offset % 8 != 0) problem = "sections out of bounds";
+  else if (snapshot_checksum(data + sizeof(snapshot_header_struct), size - sizeof(snapshot_header_struct)) != header->checksum) problem = "checksum mismatch";
+  if (problem != NULL) {
+    printf("Error: Snapshot \"%s\": %s\n", filename, problem);
+    munmap(data, size);
+    return ERROR;
+  }
+
+  // The CSR arrays are used in place; check them and the names once
+  int *offsets = (int *)(data + header->offsets_offset);
+  int *targets = (int *)(data + header->targets_offset);
+  int valid = (offsets[0] == 0 && (uint64_t)offsets[nodes] == edges);
+  for(uint64_t i=0; i < nodes && valid; i++) valid = (offsets[i] <= offsets[i + 1]);
+  for(uint64_t i=0; i < edges && valid; i++) valid = (targets[i] >= 0 && (uint64_t)targets[i] < nodes);
+  if (!valid) problem = "invalid edge index";
+
+  // Every name must start and end inside the names section
+  char *names = data + header->names_offset;
+  uint64_t names_size = header->metrics_offset - header->names_offset;
+  snapshot_metric_struct *metric_records = (snapshot_metric_struct *)(data + header->metrics_offset);
+  snapshot_node_struct *node_records = (snapshot_node_struct *)(data + header->nodes_offset);
+  for(uint64_t i=0; i < k && problem == NULL; i++) {
+    if (snapshot_name(names, names_size, metric_records[i].name) == NULL) problem = "invalid name";
+  }
+  for(uint64_t i=0; i < nodes && problem == NULL; i++) {
+    if (snapshot_name(names, names_size, node_records[i].name) == NULL ||
+	snapshot_name(names, names_size, node_records[i].description) == NULL) problem = "invalid name";
+  }
+  if (problem != NULL) {
+    printf("Error: Snapshot \"%s\": %s\n", filename, problem);
+    munmap(data, size);
+    return ERROR;
+  }
+  ctx->snapshot_data = data;
+  ctx->snapshot_size = size;
+
+  // Metric schema and nodes from the interned names
+  for(uint64_t i=0; i < k; i++) {
+    add_global_metric(ctx, names + metric_records[i].name, metric_records[i].opt, metric_records[i].combo, metric_records[i].arg);
+  }
+  for(uint64_t i=0; i < nodes; i++) {
+    add_global_node(ctx, names + node_records[i].name, names + node_records[i].description);
+  }
+
+  // CSR index and edge hash straight from the mapping
+  free_global_adjacency(ctx);
+  ctx->adj_offsets = offsets;
+  ctx->adj_targets = targets;
+  ctx->adj_metrics = (double *)(data + header->values_offset);
+  reserve_global_edge_table(ctx, edges);
+  for(uint64_t srcid=0; srcid < nodes; srcid++) {
+    for(int edge=offsets[srcid]; edge < offsets[srcid + 1]; edge++) {
+      add_global_edge_ids(ctx, srcid, targets[edge], ctx->adj_metrics + edge * k);
+    }
+  }
+
+  if (DEBUG) printf("load_snapshot: %llu metrics, %llu nodes, %llu edges\n", (unsigned long long)k, (unsigned long long)nodes, (unsigned long long)edges);
+  return 0;
+}
+
+/*
+ * free_snapshot - Unmaps the loaded snapshot
+ *
+ * Only call once nothing points into it any more (after the edge table
+ * and the adjacency index are freed or rebuilt).
+ */
+void free_snapshot(pathopt_ctx *ctx) {
+  if (ctx->snapshot_data != NULL) munmap(ctx->snapshot_data, ctx->snapshot_size);
+  ctx->snapshot_data = NULL;
+  ctx->snapshot_size = 0;
+}
@@ -0,0 +1,17 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/*************************************
+ * Compiled Graph Snapshot Functions *
+ *************************************/
+
+uint64_t snapshot_checksum(const void *data, size_t size);
+uint64_t snapshot_align(uint64_t offset);
+char *snapshot_name(char *names, uint64_t size, uint32_t offset);
+int snapshot_owns(pathopt_ctx *ctx, const void *pointer);
+int is_snapshot(char *filename);
+int write_snapshot(pathopt_ctx *ctx, char *filename);
+int load_snapshot(pathopt_ctx *ctx, char *filename);
+void free_snapshot(pathopt_ctx *ctx);
+
+#endif
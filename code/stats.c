@@ -0,0 +1,110 @@
+#include <string.h>     // memset
+#include <stdio.h>      // fprintf
+#include <time.h>       // clock_gettime
+
+#include "global.h"
+#include "graph.h"
+#include "paths.h"
+#include "stats.h"
+
+/*******************
+ * Stats Functions *
+ *******************/
+
+/*
+ * stats_clock - Reads the wall clock for the phase timers
+ *
+ * Returns seconds from the monotonic clock.
+ */
+double stats_clock() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/*
+ * pathopt_stats_enable - Turns the hot path counters on or off
+ *
+ * Arguments:
+ *   enabled - True to count
+ *
+ * The counters are kept per source, so worker threads never share one, and
+ * every count is a single branch on stats_enabled when they are off.  The
+ * phase timers always run, since they only read the clock once per phase.
+ */
+void pathopt_stats_enable(pathopt_ctx *ctx, int enabled) {
+  ctx->stats_enabled = enabled;
+}
+
+/*
+ * pathopt_stats_reset - Zeros the counters and the phase timers
+ *
+ * The path pools keep their own allocation counts, which are not reset.
+ */
+void pathopt_stats_reset(pathopt_ctx *ctx) {
+  if (ctx->source_stats != NULL) memset(ctx->source_stats, 0, ctx->global_node_total * sizeof(source_stats_struct));
+  memset(ctx->phase_seconds, 0, sizeof(ctx->phase_seconds));
+}
+
+/*
+ * pathopt_stats - Adds up the counters of every source
+ *
+ * Arguments:
+ *   stats - Filled in with the totals, the path pool usage and the phase timers
+ */
+void pathopt_stats(pathopt_ctx *ctx, pathopt_stats_struct *stats) {
+  memset(stats, 0, sizeof(pathopt_stats_struct));
+  stats->peak_srcid = ERROR;
+  stats->peak_dstid = ERROR;
+  for(int i=0; i < ctx->global_node_total && ctx->source_stats != NULL; i++) {
+    source_stats_struct *source = &ctx->source_stats[i];
+    stats->extends += source->extends;
+    stats->dominance_checks += source->dominance_checks;
+    stats->accepts += source->accepts;
+    stats->rejects += source->rejects;
+    stats->evictions += source->evictions;
+    stats->rounds += source->rounds;
+    stats->labels += source->labels;
+    if (source->rounds > stats->max_rounds) stats->max_rounds = source->rounds;
+    if (source->peak_front > stats->peak_front) {
+      stats->peak_front = source->peak_front;
+      stats->peak_srcid = i;
+      stats->peak_dstid = source->peak_dstid;
+    }
+  }
+  path_pool_stats(ctx, &stats->allocations, &stats->peak_bytes);
+  stats->parse_seconds = ctx->phase_seconds[PHASE_PARSE];
+  stats->init_seconds = ctx->phase_seconds[PHASE_INIT];
+  stats->optimize_seconds = ctx->phase_seconds[PHASE_OPTIMIZE];
+  stats->write_seconds = ctx->phase_seconds[PHASE_WRITE];
+}
+
+/*
+ * display_stats - Prints the counters and phase timers
+ *
+ * Arguments:
+ *   outfile - File pointer to print output to (includes stdout, stderr)
+ */
+void display_stats(pathopt_ctx *ctx, FILE *outfile) {
+  pathopt_stats_struct stats;
+  pathopt_stats(ctx, &stats);
+
+  fprintf(outfile, "\nStatistics\n");
+  fprintf(outfile, "  Phase seconds:     parse %.6f, init %.6f, optimize %.6f, write %.6f\n",
+	  stats.parse_seconds, stats.init_seconds, stats.optimize_seconds, stats.write_seconds);
+  fprintf(outfile, "  Path allocations:  %lu (peak %zu bytes)\n", stats.allocations, stats.peak_bytes);
+  if (!ctx->stats_enabled) {
+    fprintf(outfile, "  Counters:          disabled\n");
+    return;
+  }
+  fprintf(outfile, "  extend_path calls: %lu\n", stats.extends);
+  fprintf(outfile, "  Dominance checks:  %lu\n", stats.dominance_checks);
+  fprintf(outfile, "  Path attempts:     %lu accepted, %lu rejected\n", stats.accepts, stats.rejects);
+  fprintf(outfile, "  Evictions:         %lu\n", stats.evictions);
+  fprintf(outfile, "  Rounds:            %lu (at most %lu for one source)\n", stats.rounds, stats.max_rounds);
+  fprintf(outfile, "  Labels extended:   %lu\n", stats.labels);
+  if (stats.peak_srcid != ERROR) {
+    fprintf(outfile, "  Peak front:        %d paths (%s -> %s)\n", stats.peak_front,
+	    get_global_node_name_by_index(ctx, stats.peak_srcid), get_global_node_name_by_index(ctx, stats.peak_dstid));
+  }
+}
@@ -0,0 +1,14 @@
+#ifndef STATS_H
+#define STATS_H
+
+/*******************
+ * Stats Functions *
+ *******************/
+
+double stats_clock();
+void pathopt_stats_enable(pathopt_ctx *ctx, int enabled);
+void pathopt_stats_reset(pathopt_ctx *ctx);
+void pathopt_stats(pathopt_ctx *ctx, pathopt_stats_struct *stats);
+void display_stats(pathopt_ctx *ctx, FILE *outfile);
+
+#endif
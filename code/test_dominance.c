@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "global.h"
+#include "dominance.h"
+
+// Largest block and metric count to try
+#define TEST_MAX_ROWS 37
+#define TEST_MAX_METRICS 8
+#define TEST_BLOCKS 20000
+
+/*
+ * random_value - Picks a metric value from a small set so ties are common
+ */
+double random_value() {
+  return (double)(rand() % 4) - 1.5;
+}
+
+/*
+ * check_block - Compares every dominance kernel on one block
+ *
+ * Arguments:
+ *   rows      - count metric vectors stored one after the other
+ *   count     - Number of rows
+ *   size      - Number of metrics in each row
+ *   candidate - Normalized metric vector to test
+ *
+ * Returns the number of kernels that disagree with the scalar ones.
+ */
+int check_block(const double *rows, int count, int size, const double *candidate) {
+  int expected = dominance_find_scalar(rows, count, size, candidate);
+  int failures = 0;
+
+  if (dominance_find(rows, count, size, candidate) != expected) failures++;
+#if defined(__SSE2__)
+  if (dominance_find_sse2(rows, count, size, candidate) != expected) failures++;
+#endif
+#if defined(__SSE2__) && defined(__GNUC__)
+  if (__builtin_cpu_supports("avx") && dominance_find_avx(rows, count, size, candidate) != expected) failures++;
+#endif
+  for (int i=0; i < count; i++) {
+    const double *row = rows + i * size;
+    if (dominates_vector(row, candidate, size) != dominates_vector_scalar(row, candidate, size)) failures++;
+    if (dominates_vector(candidate, row, size) != dominates_vector_scalar(candidate, row, size)) failures++;
+  }
+
+  if (failures > 0) printf("Mismatch: %d rows, %d metrics, expected row %d\n", count, size, expected);
+  return failures;
+}
+
+/*
+ * main - Runs every kernel on random blocks and compares the answers
+ *
+ * Blocks have 1 to TEST_MAX_METRICS metrics and 0 to TEST_MAX_ROWS rows, so
+ * counts that are not a multiple of the vector width are covered, and the
+ * values come from a set of four so equal rows and equal metrics are
+ * common.  Exits with 1 if any kernel disagrees with the scalar kernels.
+ */
+int main() {
+  double rows[TEST_MAX_ROWS * TEST_MAX_METRICS];
+  double candidate[TEST_MAX_METRICS];
+  int failures = 0;
+
+  srand(1);
+  for (int block=0; block < TEST_BLOCKS; block++) {
+    int size = 1 + block % TEST_MAX_METRICS;
+    int count = rand() % (TEST_MAX_ROWS + 1);
+    for (int i=0; i < count * size; i++) rows[i] = random_value();
+    for (int m=0; m < size; m++) candidate[m] = random_value();
+    // Sometimes make the candidate equal to a row
+    if (count > 0 && block % 5 == 0) {
+      int row = rand() % count;
+      for (int m=0; m < size; m++) candidate[m] = rows[row * size + m];
+    }
+    failures += check_block(rows, count, size, candidate);
+  }
+
+#if defined(__AVX__)
+  printf("Dominance kernels (AVX build): ");
+#else
+  printf("Dominance kernels: ");
+#endif
+  if (failures > 0) {
+    printf("%d mismatches in %d blocks\n", failures, TEST_BLOCKS);
+    return 1;
+  }
+  printf("%d blocks OK\n", TEST_BLOCKS);
+  return 0;
+}
@@ -0,0 +1,179 @@
+#!/usr/bin/python3
+
+import argparse
+import math
+import random
+import sys
+
+# Metric kinds, cycled through by ordinal: (name, optimize, combination)
+METRIC_KINDS = [("cost", "MIN", "ADD"), ("delay", "MIN", "ADD+1"), ("bandwidth", "MAX", "MIN")]
+
+# Values are drawn from 1..METRIC_RANGE
+METRIC_RANGE = 100
+
+#######################
+# Topology Generators #
+#######################
+# Each returns (node count, set of directed (srcid, dstid) edges)
+
+def bidirectional(links):
+    edges = set()
+    for a, b in links:
+        if a != b:
+            edges.add((a, b))
+            edges.add((b, a))
+    return edges
+
+def random_sparse(nodes, degree, rng):
+    # A random ring keeps the graph strongly connected; the rest of each
+    # node's out-degree goes to random other nodes
+    order = list(range(nodes))
+    rng.shuffle(order)
+    edges = {(order[i], order[(i + 1) % nodes]) for i in range(nodes)} if nodes > 1 else set()
+    for src in range(nodes):
+        targets = min(degree, nodes - 1)
+        while sum(1 for dst in range(nodes) if (src, dst) in edges) < targets:
+            dst = rng.randrange(nodes)
+            if dst != src:
+                edges.add((src, dst))
+    return nodes, edges
+
+def grid(nodes, degree, rng, wrap=False):
+    # rows x cols lattice with 4-neighbour links (degree is fixed); a torus
+    # also links the last row and column back to the first
+    cols = max(1, int(math.sqrt(nodes)))
+    rows = max(1, nodes // cols)
+    links = []
+    for r in range(rows):
+        for c in range(cols):
+            here = r * cols + c
+            if c + 1 < cols or (wrap and cols > 2):
+                links.append((here, r * cols + (c + 1) % cols))
+            if r + 1 < rows or (wrap and rows > 2):
+                links.append((here, ((r + 1) % rows) * cols + c))
+    return rows * cols, bidirectional(links)
+
+def torus(nodes, degree, rng):
+    return grid(nodes, degree, rng, wrap=True)
+
+def fat_tree(nodes, degree, rng):
+    # Switch level k-ary fat-tree (k even): k pods of k/2 edge and k/2
+    # aggregation switches under (k/2)^2 core switches, 5k^2/4 in all.
+    # k is the smallest that gives at least the requested node count.
+    k = 2
+    while 5 * k * k // 4 < nodes:
+        k += 2
+    half = k // 2
+    core = half * half
+    links = []
+    for pod in range(k):
+        aggregation = core + pod * k
+        edge = aggregation + half
+        for a in range(half):
+            for e in range(half):
+                links.append((aggregation + a, edge + e))
+            for c in range(half):
+                links.append((aggregation + a, a * half + c))
+    return core + k * k, bidirectional(links)
+
+def ring_of_rings(nodes, degree, rng):
+    # About sqrt(nodes) rings of about sqrt(nodes) nodes, with the first
+    # node of each ring on a backbone ring
+    size = max(3, int(math.sqrt(nodes)))
+    rings = max(1, nodes // size)
+    links = []
+    for ring in range(rings):
+        first = ring * size
+        links.extend((first + i, first + (i + 1) % size) for i in range(size))
+        if rings > 1:
+            links.append((first, ((ring + 1) % rings) * size))
+    return rings * size, bidirectional(links)
+
+def scale_free(nodes, degree, rng):
+    # Barabasi-Albert preferential attachment: each new node links to
+    # degree/2 existing nodes picked in proportion to their degree
+    links_per_node = max(1, degree // 2)
+    seed = min(nodes, links_per_node + 1)
+    links = [(a, b) for a in range(seed) for b in range(a + 1, seed)]
+    ends = [node for link in links for node in link] or list(range(seed))
+    for node in range(seed, nodes):
+        targets = set()
+        while len(targets) < min(links_per_node, node):
+            targets.add(rng.choice(ends))
+        for target in targets:
+            links.append((node, target))
+            ends.extend((node, target))
+    return nodes, bidirectional(links)
+
+FAMILIES = {"random": random_sparse, "grid": grid, "torus": torus, "fattree": fat_tree,
+            "rings": ring_of_rings, "scalefree": scale_free}
+
+##################
+# Edge Metrics   #
+##################
+
+def metric_schema(count):
+    # cost, delay, bandwidth, cost2, delay2, bandwidth2, ...
+    schema = []
+    for i in range(count):
+        name, opt, combo = METRIC_KINDS[i % len(METRIC_KINDS)]
+        schema.append((name + (str(i // len(METRIC_KINDS) + 1) if i >= len(METRIC_KINDS) else ""), opt, combo))
+    return schema
+
+def edge_values(schema, correlation, rng):
+    # Every metric shares one Gaussian component, weighted by the
+    # correlation: 1 makes an edge that is good on one metric good on all,
+    # 0 makes them independent and -1 trades the first metric off against
+    # the rest.  Quality maps to 1..METRIC_RANGE, higher values being worse
+    # for MIN metrics and better for MAX metrics.
+    shared = rng.gauss(0, 1)
+    weight = abs(correlation)
+    values = []
+    for i, (name, opt, combo) in enumerate(schema):
+        direction = -1 if (correlation < 0 and i > 0) else 1
+        badness = direction * weight * shared + math.sqrt(1 - weight * weight) * rng.gauss(0, 1)
+        quantile = 0.5 * (1 + math.erf(badness / math.sqrt(2)))
+        value = 1 + min(METRIC_RANGE - 1, int(quantile * METRIC_RANGE))
+        values.append(value if opt == "MIN" else METRIC_RANGE + 1 - value)
+    return values
+
+def write_topology(outfile, family, nodes, degree=4, metrics=3, correlation=0.0, seed=1):
+    # Writes a graph in the pathopt text format; returns (nodes, edges) written
+    rng = random.Random(seed)
+    nodes, edges = FAMILIES[family](nodes, degree, rng)
+    schema = metric_schema(metrics)
+
+    outfile.write("[metrics]\n#NAME|Optimize|Combination\n")
+    for name, opt, combo in schema:
+        outfile.write("%s|%s|%s\n" % (name, opt, combo))
+    outfile.write("\n[nodes]\n#NAME|description\n")
+    for node in range(nodes):
+        outfile.write("n%d|%s node %d\n" % (node, family, node))
+    outfile.write("\n[edges]\n#SRCNAME|DSTNAME|METRIC=VALUE,METRIC=VALUE,...\n")
+    for src, dst in sorted(edges):
+        values = edge_values(schema, correlation, rng)
+        outfile.write("n%d|n%d|%s\n" % (src, dst, ",".join("%s=%d" % (name, value) for (name, _, _), value in zip(schema, values))))
+    return nodes, len(edges)
+
+###################
+# Execute to Test #
+###################
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Writes a synthetic topology in the pathopt text format")
+    parser.add_argument("family", choices=sorted(FAMILIES))
+    parser.add_argument("-n", "--nodes", type=int, default=100, help="node count (grid, torus, fattree and rings round it to their shape)")
+    parser.add_argument("-d", "--degree", type=int, default=4, help="out-degree (random) or twice the links per new node (scalefree)")
+    parser.add_argument("-m", "--metrics", type=int, default=3, help="metric count, cycling through cost, delay and bandwidth")
+    parser.add_argument("-c", "--correlation", type=float, default=0.0, help="correlation between metric quality, -1 to 1")
+    parser.add_argument("-s", "--seed", type=int, default=1)
+    parser.add_argument("-o", "--output", help="output file (default stdout)")
+    args = parser.parse_args()
+    if not -1 <= args.correlation <= 1:
+        parser.error("correlation must be between -1 and 1")
+    if args.nodes < 1 or args.metrics < 1:
+        parser.error("nodes and metrics must be positive")
+
+    outfile = open(args.output, "w") if args.output else sys.stdout
+    write_topology(outfile, args.family, args.nodes, args.degree, args.metrics, args.correlation, args.seed)
+    if args.output:
+        outfile.close()